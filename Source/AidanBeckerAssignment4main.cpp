@@ -2,6 +2,12 @@
 #include <stdio.h>
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 
 //Opengl includes
 #include <GL/glew.h>
@@ -10,6 +16,19 @@
 //Project-specific includes
 #include "SierpinskiPyramid.h"
 #include "IBOCube.h"
+#include "CubeInstanceBatch.h"
+#include "SnowParticles.h"
+#include "JobSystem.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "OffscreenTarget.h"
+#include "FrameStats.h"
+#include "StartupProfiler.h"
+#include "FrameProfiler.h"
+#include "BoundingVolumes.h"
+#include "FrameUniforms.h"
+#include "ForestBatch.h"
+#include "Random.h"
 #include "AidanGLCamera.h"
 #include "UsefulFunctions.h"
 
@@ -17,18 +36,102 @@
 // Declaration of Camera object
 Camera camera = Camera();
 
-const int numTrees = 100;
-const int amountOfSnow = 1000;
+// Scene description, set with --scene FILE and/or --trees N, --snow N, --level N, --plane X Z, --seed N
+// Flags and files are read in order, so a flag after --scene overrides the file
+int numTrees = 100;
+int amountOfSnow = 1000;
+int treeLevel = 3;                  // fractal level every tree starts at
+float planeSizeX = 15;              // half the ground's size, trees and snow are spread over all of it
+float planeSizeZ = 15;
+unsigned int sceneSeed = 0;         // random placement, picked from the clock unless one is given
+bool sceneSeedSet = false;
+const int maxTrees = 1000000;
+const int maxSnow = 1000000;
+const int maxTreeLevel = 4;         // SierpinskiPyramid wraps anything past this back to level 0
 // Declaration of Sierpinski Pyramid object(s) as tree leaves
-SierpinskiPyramid leaves[numTrees];
+// Sized once the scene is read, never resized after (culling keeps pointers to them)
+std::vector<SierpinskiPyramid> leaves;
 // Declaration of tree trunks as cubes
-IBOCube trunks[numTrees];
+std::vector<IBOCube> trunks;
 // Ground is a very squished cube
 IBOCube ground = IBOCube();
 // Moon is also just a cube
 IBOCube moon = IBOCube();
-// Snow is just a lot of cubes
-IBOCube snow[amountOfSnow];
+// Snow is just a lot of cubes, drawn all at once
+CubeInstanceBatch snow;
+// Snow positions are kept and moved separately from the cubes
+SnowParticles snowParticles;
+glm::vec3 snowWind(0, 0, 0);
+
+// Worker threads for per-frame updates, --threads N (0 means one per core)
+// Only the main thread ever talks to OpenGL
+JobSystem jobs;
+int threadCount = 0;
+
+// Every frame's draws, sorted by pass and shader before they're submitted
+RenderQueue renderQueue;
+// View, projection and time, uploaded once a frame for every shader
+FrameUniforms frameUniforms;
+
+// Frustum culling for trees, trunks, ground and moon, --no-cull or C turns it off
+// Snow is a single instanced draw, so it's always submitted
+bool frustumCulling = true;
+std::vector<Renderable*> cullObjects;       // leaves, then trunks, then ground and moon
+std::vector<AABB> cullBounds;               // world-space box of each object, updated every frame
+std::vector<int> visibleObjects;
+BoundingVolumeHierarchy sceneBVH;
+Frustum viewFrustum;
+
+// Trees pick their level from their size on screen, --no-lod or L draws them all at the clicked level
+bool levelOfDetail = true;
+// --pyramid-geometry-shader draws the trees the old way, working out normals in a geometry shader
+bool pyramidGeometryShader = false;
+// --cube-geometry-shader draws trunks, ground, moon and snow through the old pass-through geometry stage
+bool cubeGeometryShader = false;
+// Every visible leaf and trunk in a few draw calls, --no-forest-batch draws them one by one
+// --no-multi-draw keeps the batch but uses an instanced draw per leaf level
+// The batch has no geometry shader path, so either geometry shader flag turns it off
+ForestBatch forest;
+bool forestBatching = true;
+// Faces and wireframe drawn in one pass, edges found in the fragment shader
+// --single-pass-wireframe or O turns it on, otherwise objects draw twice with GL_LINE for the wireframe
+bool singlePass = false;
+
+// Per-stage CPU time, summed over a few seconds and then printed as averages
+// Also counts GL state calls that were sent or dropped as redundant, objects left after culling
+// tetrahedra drawn for the leaves, draw calls, and draw calls for the batched forest
+struct StageTimes {
+    double camera, trees, snow, cull, draw;
+    double stateCallsIssued, stateCallsSkipped, drawCalls;
+    double visibleObjects, leafTetrahedra, forestDraws;
+    int frames;
+};
+StageTimes stageTimes = StageTimes();
+const double stageReportInterval = 2.0;     //seconds between reports
+
+// Frame profiling, --trace FILE writes the last frames' CPU/GPU zones as Chrome trace JSON on exit
+// --overlay (or P) shows per-stage ms in the window title, printed instead when headless
+std::string tracePath;
+bool profileOverlay = false;
+const double overlayInterval = 0.5;         //seconds between overlay updates
+const char* windowTitle = "Aidan Becker Assignment 4";
+
+// Headless benchmark mode, --headless [--frames N] [--width W] [--height H] [--report FILE]
+// Draws into an offscreen framebuffer with a scripted camera for a fixed number
+// of frames, then writes frame time statistics as JSON
+bool headless = false;
+int headlessFrames = 600;
+int headlessWidth = 1280;
+int headlessHeight = 720;
+const int headlessWarmupFrames = 10;            //frames drawn before timing starts
+const double headlessFrameTime = 1.0/60.0;      //fixed scene step so every run draws the same frames
+std::string reportPath = "headless_report.json";
+
+// Milliseconds since a given time point
+double msSince(const std::chrono::steady_clock::time_point &since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
 
 // Global view/projection matrices so they're accessible from
 // glfwkeyboard callback functions
@@ -50,6 +153,86 @@ glm::vec3 cameraPosition(0, 0.75, -2);                         //initial camera
 
 int windowWidth, windowHeight, windowSizeX, windowSizeY;    //Screen space values
 
+// Prints the size of a tree's requested fractal level
+// Every tree shares the same level, so one report covers all of them
+// With level of detail on, that's the level at the reference size, nearer trees draw more
+void reportPyramidSize(SierpinskiPyramid &pyramid)
+{
+    std::cout << "Level " << pyramid.getLevel() << ": "
+        << pyramid.getVertexCount() << " vertices per tree, "
+        << SierpinskiGeometryCache::liveCount() << " shared mesh(es) for "
+        << numTrees << " trees" << std::endl;
+}
+
+// Aerial view slowly circling the scene, used by the spinning view and headless runs
+glm::mat4 spinningViewMatrix(double time)
+{
+    return glm::lookAt(
+        glm::vec3((float)cos(time*0.2)*15, 15, (float)sin(time*0.2)*15),
+        glm::vec3(0, 0, 0),
+        glm::vec3(0, 1, 0)
+    );
+}
+
+// Writes the results of a headless run as JSON
+bool writeHeadlessReport(FrameStats &stats)
+{
+    std::ofstream out(reportPath.c_str());
+    if(!out)
+    {
+        std::cerr << "couldn't open " << reportPath << " for writing" << std::endl;
+        return false;
+    }
+    int frames = stats.size() > 0 ? stats.size() : 1;
+    out << "{" << std::endl
+        << "  \"frames\": " << stats.size() << "," << std::endl
+        << "  \"warmupFrames\": " << headlessWarmupFrames << "," << std::endl
+        << "  \"width\": " << headlessWidth << "," << std::endl
+        << "  \"height\": " << headlessHeight << "," << std::endl
+        << "  \"threads\": " << jobs.getThreadCount() << "," << std::endl
+        << "  \"trees\": " << numTrees << "," << std::endl
+        << "  \"treeLevel\": " << leaves[0].getLevel() << "," << std::endl
+        << "  \"planeSize\": [" << planeSizeX << ", " << planeSizeZ << "]," << std::endl
+        << "  \"seed\": " << sceneSeed << "," << std::endl
+        << "  \"pyramidShader\": \"" << (pyramidGeometryShader ? "geometry" : "vertex") << "\"," << std::endl
+        << "  \"cubeShader\": \"" << (cubeGeometryShader ? "geometry" : "vertex") << "\"," << std::endl
+        << "  \"snow\": " << amountOfSnow << "," << std::endl
+        << "  \"startupMs\": " << StartupProfiler::getTotalMs() << "," << std::endl
+        << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\"," << std::endl;
+    stats.writeJson(out, "  ");
+    out << "," << std::endl
+        << "  \"stageMs\": {"
+        << "\"camera\": " << stageTimes.camera/frames
+        << ", \"trees\": " << stageTimes.trees/frames
+        << ", \"snow\": " << stageTimes.snow/frames
+        << ", \"cull\": " << stageTimes.cull/frames
+        << ", \"draw\": " << stageTimes.draw/frames
+        << "}," << std::endl
+        << "  \"culling\": {"
+        << "\"enabled\": " << (frustumCulling ? "true" : "false")
+        << ", \"visible\": " << stageTimes.visibleObjects/frames
+        << ", \"total\": " << cullObjects.size()
+        << "}," << std::endl
+        << "  \"lod\": {"
+        << "\"enabled\": " << (levelOfDetail ? "true" : "false")
+        << ", \"leafTetrahedra\": " << stageTimes.leafTetrahedra/frames
+        << "}," << std::endl
+        << "  \"singlePassWireframe\": " << (singlePass ? "true" : "false") << "," << std::endl
+        << "  \"drawCalls\": " << stageTimes.drawCalls/frames << "," << std::endl
+        << "  \"forestBatch\": {"
+        << "\"enabled\": " << (forestBatching ? "true" : "false")
+        << ", \"multiDrawIndirect\": " << (forestBatching && forest.usesMultiDrawIndirect() ? "true" : "false")
+        << ", \"drawCalls\": " << stageTimes.forestDraws/frames
+        << "}," << std::endl
+        << "  \"glStateCalls\": {"
+        << "\"issued\": " << stageTimes.stateCallsIssued/frames
+        << ", \"skipped\": " << stageTimes.stateCallsSkipped/frames
+        << "}" << std::endl
+        << "}" << std::endl;
+    std::cout << "Wrote " << stats.size() << " frame times to " << reportPath << std::endl;
+    return true;
+}
+
 // mousebutton callback function
 // Performs an action once, the first time a mouse button is pressed
 // A left click generates more triangles, while a right click resets to original triangles
@@ -61,6 +244,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         {
             leaves[i].fractalize();
         }
+        reportPyramidSize(leaves[0]);
     }
     else if(button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
     {
@@ -68,6 +252,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         {
             leaves[i].reset();
         }
+        reportPyramidSize(leaves[0]);
     }
 
 }
@@ -158,10 +343,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                     trunks[i].drawAsWireframe();
                     leaves[i].drawAsWireframe();
                 }
-                for(int i = 0; i < amountOfSnow; i++)
-                {
-                    snow[i].drawAsWireframe();
-                }
+                snow.drawAsWireframe();
                 ground.drawAsWireframe();
                 moon.drawAsWireframe();
                 break;
@@ -171,13 +353,35 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                     trunks[i].drawAsFaces();
                     leaves[i].drawAsFaces();
                 }
-                for(int i = 0; i < amountOfSnow; i++)
-                {
-                    snow[i].drawAsFaces();
-                }
+                snow.drawAsFaces();
                 ground.drawAsFaces();
                 moon.drawAsFaces();
                 break;
+            case GLFW_KEY_O:        // O toggles drawing faces and wireframe in one pass
+                singlePass = !singlePass;
+                singlePassWireframe() = singlePass;
+                std::cout << "Single-pass wireframe " << (singlePass ? "on" : "off") << std::endl;
+                break;
+            case GLFW_KEY_P:        // P toggles the profiling overlay
+                profileOverlay = !profileOverlay;
+                FrameProfiler::setEnabled(profileOverlay || !tracePath.empty());
+                if(!profileOverlay)
+                {
+                    glfwSetWindowTitle(window, windowTitle);
+                }
+                break;
+            case GLFW_KEY_C:        // C toggles frustum culling
+                frustumCulling = !frustumCulling;
+                std::cout << "Frustum culling " << (frustumCulling ? "on" : "off") << std::endl;
+                break;
+            case GLFW_KEY_L:        // L toggles distance-based tree detail
+                levelOfDetail = !levelOfDetail;
+                for(int i = 0; i < numTrees; i++)
+                {
+                    leaves[i].setLodEnabled(levelOfDetail);
+                }
+                std::cout << "Tree level of detail " << (levelOfDetail ? "on" : "off") << std::endl;
+                break;
             case GLFW_KEY_R:        // R resets to both wireframe and faces rendering
                 for(int i = 0; i < numTrees; i++)
                 {
@@ -186,11 +390,8 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                     leaves[i].drawAsFaces();
                     leaves[i].toggleWireframe();
                 }
-                for(int i = 0; i < amountOfSnow; i++)
-                {
-                    snow[i].drawAsFaces();
-                    snow[i].toggleWireframe();
-                }
+                snow.drawAsFaces();
+                snow.toggleWireframe();
                 ground.drawAsFaces();
                 ground.toggleWireframe();
                 moon.drawAsFaces();
@@ -210,7 +411,217 @@ void glfwErrorCB(int error, const char* description) {
 }
 
 
-int main() {
+// Reads a scene description, one setting per line, # starts a comment
+//   trees 1000
+//   snow 5000
+//   level 3
+//   plane 15 15
+//   seed 42
+//   wind 0.5 0
+// Anything not in the file keeps its current value
+bool loadScene(const std::string &path)
+{
+    std::ifstream in(path.c_str());
+    if(!in)
+    {
+        std::cerr << "couldn't open scene " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while(std::getline(in, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string key;
+        if(!(fields >> key))
+        {
+            continue;
+        }
+        bool ok;
+        if(key == "trees")
+        {   ok = (bool)(fields >> numTrees);  }
+        else if(key == "snow")
+        {   ok = (bool)(fields >> amountOfSnow);  }
+        else if(key == "level")
+        {   ok = (bool)(fields >> treeLevel);  }
+        else if(key == "plane")
+        {   ok = (bool)(fields >> planeSizeX >> planeSizeZ);  }
+        else if(key == "seed")
+        {   ok = (bool)(fields >> sceneSeed);  sceneSeedSet = true;  }
+        else if(key == "wind")
+        {   ok = (bool)(fields >> snowWind.x >> snowWind.z);  }
+        else
+        {   ok = false;  }
+        if(!ok)
+        {
+            std::cerr << path << ":" << lineNumber << ": couldn't read \"" << line << "\"" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    // Read command line options
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--scene" && i+1 < argc)
+        {
+            if(!loadScene(argv[++i]))
+            {
+                return -1;
+            }
+        }
+        else if(arg == "--trees" && i+1 < argc)
+        {
+            numTrees = atoi(argv[++i]);
+        }
+        else if(arg == "--snow" && i+1 < argc)
+        {
+            amountOfSnow = atoi(argv[++i]);
+        }
+        else if(arg == "--level" && i+1 < argc)
+        {
+            treeLevel = atoi(argv[++i]);
+        }
+        else if(arg == "--plane" && i+2 < argc)
+        {
+            planeSizeX = atof(argv[++i]);
+            planeSizeZ = atof(argv[++i]);
+        }
+        else if(arg == "--seed" && i+1 < argc)
+        {
+            sceneSeed = strtoul(argv[++i], NULL, 10);
+            sceneSeedSet = true;
+        }
+        else if(arg == "--wind" && i+2 < argc)
+        {
+            snowWind.x = atof(argv[++i]);
+            snowWind.z = atof(argv[++i]);
+        }
+        else if(arg == "--threads" && i+1 < argc)
+        {
+            threadCount = atoi(argv[++i]);
+        }
+        else if(arg == "--shader-cache" && i+1 < argc)
+        {
+            // Linked programs are saved here and loaded instead of compiled next time
+            ShaderLibrary::setBinaryCacheDirectory(argv[++i]);
+        }
+        else if(arg == "--mesh-cache" && i+1 < argc)
+        {
+            // Generated pyramid levels are saved here and mapped instead of generated next time
+            SierpinskiMeshFile::setDirectory(argv[++i]);
+        }
+        else if(arg == "--headless")
+        {
+            headless = true;
+        }
+        else if(arg == "--frames" && i+1 < argc)
+        {
+            headlessFrames = atoi(argv[++i]);
+        }
+        else if(arg == "--width" && i+1 < argc)
+        {
+            headlessWidth = atoi(argv[++i]);
+        }
+        else if(arg == "--height" && i+1 < argc)
+        {
+            headlessHeight = atoi(argv[++i]);
+        }
+        else if(arg == "--report" && i+1 < argc)
+        {
+            reportPath = argv[++i];
+        }
+        else if(arg == "--trace" && i+1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if(arg == "--overlay")
+        {
+            profileOverlay = true;
+        }
+        else if(arg == "--no-cull")
+        {
+            frustumCulling = false;
+        }
+        else if(arg == "--no-lod")
+        {
+            levelOfDetail = false;
+        }
+        else if(arg == "--pyramid-geometry-shader")
+        {
+            pyramidGeometryShader = true;
+            SierpinskiPyramid::setGeometryShaderPath(true);
+        }
+        else if(arg == "--cube-geometry-shader")
+        {
+            cubeGeometryShader = true;
+            IBOCube::setGeometryShaderPath(true);
+            CubeInstanceBatch::setGeometryShaderPath(true);
+        }
+        else if(arg == "--no-forest-batch")
+        {
+            forestBatching = false;
+        }
+        else if(arg == "--no-multi-draw")
+        {
+            ForestBatch::setMultiDrawIndirectAllowed(false);
+        }
+        else if(arg == "--single-pass-wireframe")
+        {
+            singlePass = true;
+            singlePassWireframe() = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--scene FILE] [--trees N] [--snow N] [--level N] [--plane X Z] [--seed N]\n"
+                "       [--wind X Z] [--threads N] [--shader-cache DIR] [--mesh-cache DIR]\n"
+                "       [--trace FILE] [--overlay] [--no-cull] [--no-lod]\n"
+                "       [--pyramid-geometry-shader] [--cube-geometry-shader]\n"
+                "       [--no-forest-batch] [--no-multi-draw] [--single-pass-wireframe]\n"
+                "       [--headless [--frames N] [--width W] [--height H] [--report FILE]]\n", argv[0]);
+            return -1;
+        }
+    }
+    if(numTrees < 1 || numTrees > maxTrees)
+    {
+        fprintf(stderr, "trees must be between 1 and %d\n", maxTrees);
+        return -1;
+    }
+    if(amountOfSnow < 0 || amountOfSnow > maxSnow)
+    {
+        fprintf(stderr, "snow must be between 0 and %d\n", maxSnow);
+        return -1;
+    }
+    if(treeLevel < 0 || treeLevel > maxTreeLevel)
+    {
+        fprintf(stderr, "level must be between 0 and %d\n", maxTreeLevel);
+        return -1;
+    }
+    if(planeSizeX <= 0 || planeSizeZ <= 0)
+    {
+        fprintf(stderr, "plane sizes must be positive\n");
+        return -1;
+    }
+    if(forestBatching && (pyramidGeometryShader || cubeGeometryShader))
+    {
+        std::cout << "Geometry shader paths draw the forest one tree at a time" << std::endl;
+        forestBatching = false;
+    }
+    if(headless && (headlessFrames <= 0 || headlessWidth <= 0 || headlessHeight <= 0))
+    {
+        fprintf(stderr, "--frames, --width and --height must be positive\n");
+        return -1;
+    }
+
+    // Time every phase of startup, printed once the scene is ready
+    StartupProfiler::start("startup");
+    StartupProfiler::begin("GLFW + GLEW init");
+
     // Start a timer to check frame times
     double start = glfwGetTime();
     double current = start;
@@ -238,12 +649,30 @@ int main() {
     // Open a window and create its OpenGL context
     GLFWwindow* window;
 
-    // Check size of screen's available work area
-    // This is the area not taken up by taskbars and other OS objects
-    glfwGetMonitorWorkarea(glfwGetPrimaryMonitor(), &windowWidth, &windowHeight, &windowSizeX, &windowSizeY);
-    
-    // make window
-    window = glfwCreateWindow( windowSizeX, windowSizeY, "Aidan Becker Assignment 4", NULL, NULL);
+    if(headless)
+    {
+        // The window is never shown, it only owns the context
+        // Everything is drawn into an offscreen framebuffer of the requested size instead
+        windowSizeX = headlessWidth;
+        windowSizeY = headlessHeight;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow( windowSizeX, windowSizeY, windowTitle, NULL, NULL);
+        if(window == NULL)
+        {
+            // Software-only machines may still have Mesa's offscreen context
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            window = glfwCreateWindow( windowSizeX, windowSizeY, windowTitle, NULL, NULL);
+        }
+    }
+    else
+    {
+        // Check size of screen's available work area
+        // This is the area not taken up by taskbars and other OS objects
+        glfwGetMonitorWorkarea(glfwGetPrimaryMonitor(), &windowWidth, &windowHeight, &windowSizeX, &windowSizeY);
+
+        // make window
+        window = glfwCreateWindow( windowSizeX, windowSizeY, windowTitle, NULL, NULL);
+    }
     if( window == NULL ){
         fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible.\n" );
         glfwTerminate();
@@ -254,80 +683,151 @@ int main() {
         fprintf(stderr, "Failed to initialize GLEW\n");
         return -1;
     }
+    StartupProfiler::end();
+
+    // View, projection and time are shared by every shader, set up before any of them load
+    frameUniforms.init();
 
     // Ensure we can capture the escape key and mouse clicks being pressed below
     // This sets a flag that a key has been pressed, even if it was between frames
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
     glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GL_TRUE);
 
-    // Initialize camera object
-    camera.init(
-        window, cameraPosition, 
-        glm::perspective(
+    StartupProfiler::begin("camera + render target");
+    OffscreenTarget offscreen;
+    FrameStats frameStats;
+    if(headless)
+    {
+        if(!offscreen.init(headlessWidth, headlessHeight))
+        {
+            glfwTerminate();
+            return -1;
+        }
+        offscreen.bind();
+        frameStats.init(headlessFrames);
+
+        // Scripted camera: the spinning view, with nothing read from the mouse or keyboard
+        userCameraInput = false;
+        spinningView = true;
+        projectionMatrix = glm::perspective(
             glm::radians<float>(55),
             (float)windowSizeX/(float)windowSizeY,
-            0.01f, 
+            0.01f,
             100.0f
-        ),
-        horizontalAngle, verticalAngle,
-        cameraSpeed*2, mouseSensitivity,
-        true
-    );
+        );
+    }
+    else
+    {
+        // Initialize camera object
+        camera.init(
+            window, cameraPosition, 
+            glm::perspective(
+                glm::radians<float>(55),
+                (float)windowSizeX/(float)windowSizeY,
+                0.01f, 
+                100.0f
+            ),
+            horizontalAngle, verticalAngle,
+            cameraSpeed*2, mouseSensitivity,
+            true
+        );
+    }
+
+    StartupProfiler::end();
+
+    // Start worker threads
+    // Fractal meshes are built on them too, only their upload happens on this thread
+    StartupProfiler::begin("job system");
+    jobs.init(threadCount);
+    SierpinskiGeometryCache::setJobSystem(&jobs);
+    StartupProfiler::end();
+    std::cout << "Updating scene with " << jobs.getThreadCount() << " thread(s)" << std::endl;
 
     // initialize random number generator for random trees
-    srand((int)(glfwGetTime()*100000));
+    // Printed so a run can be placed the same way again with --seed
+    if(!sceneSeedSet)
+    {
+        sceneSeed = (unsigned int)(glfwGetTime()*100000);
+    }
+    Random::setSeed(sceneSeed);
+    std::cout << "Scene: " << numTrees << " trees, " << amountOfSnow << " snow, "
+        << planeSizeX*2 << "x" << planeSizeZ*2 << " plane, seed " << sceneSeed << std::endl;
 
-    // set size of the base platform
-    float planeSizeX = 15;
-    float planeSizeZ = 15;
+    leaves.resize(numTrees);
+    trunks.resize(numTrees);
 
+    StartupProfiler::begin("trees");
+    StartupProfiler::begin("leaves");
     leaves[0].init(window, 
         glm::vec3(0, 1, 0),                                     //position in non-modelspace
         glm::scale(glm::vec3(1.0f, 1.0f, 1.0f)),                //scale in non-modelspace
         glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),    //rotation in non-modelspace
         glm::vec3(0, 0.2, 0)                                    //color value
     );
-    for(int i = 0; i < 3; i++)
-    {
-        leaves[0].fractalize();
-    }
+    leaves[0].generateLevel(treeLevel);
+    leaves[0].setLodEnabled(levelOfDetail);
+    StartupProfiler::end();
+    StartupProfiler::begin("trunks");
     trunks[0].init(window,
         glm::vec3(0, 0.3, 0),                         //position in non-modelspace
         glm::scale(glm::vec3(0.3f, 0.7, 0.3f)),                   //scale in non-modelspace
         glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),    //rotation in non-modelspace
         glm::vec3(0.3255, 0.2078, 0.0392)                       //color value
     );
+    StartupProfiler::end();
+    // Tree and snow placement get their own streams, so changing one doesn't move the other
+    Random treeRandom(sceneSeed, Random::treeStream);
+    std::vector<float> treeX(numTrees), treeZ(numTrees);
+    treeRandom.fillBetween(treeX.data(), numTrees, -1, 1);
+    treeRandom.fillBetween(treeZ.data(), numTrees, -1, 1);
     for(int i = 1; i < numTrees; i++)
     {
-        float randX = randomBetween(-1, 1);
-        float randZ = randomBetween(-1, 1);
+        float randX = treeX[i];
+        float randZ = treeZ[i];
+        StartupProfiler::begin("leaves");
         leaves[i].init(window, 
             glm::vec3(0 + randX*planeSizeX, 1, 0 + randZ*planeSizeZ),   //position in non-modelspace
             glm::scale(glm::vec3(1.0f, 1.0f, 1.0f)),                    //scale in non-modelspace
             glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),        //rotation in non-modelspace
             glm::vec3(0, 0.2, 0)                                        //color value
         );
-        // default is a level 3 pyramid
-        for(int j = 0; j < 3; j++)
-        {
-            leaves[i].fractalize();
-        }
+        // every tree starts at the scene's level, 3 unless set
+        leaves[i].generateLevel(treeLevel);
+        leaves[i].setLodEnabled(levelOfDetail);
+        StartupProfiler::end();
+        StartupProfiler::begin("trunks");
         trunks[i].init(window,
             glm::vec3(randX*planeSizeX, 0.3, randZ*planeSizeZ),   //position in non-modelspace
             glm::scale(glm::vec3(0.3f, 0.7, 0.3f)),                                   //scale in non-modelspace
             glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),                    //rotation in non-modelspace
             glm::vec3(0.3255, 0.2078, 0.0392)                                       //color value
         );
+        StartupProfiler::end();
     }
+    StartupProfiler::end();
+    reportPyramidSize(leaves[0]);
+    StartupProfiler::begin("snow");
+    snow.init(window, amountOfSnow);
+    snowParticles.init(amountOfSnow, 5, planeSizeX, planeSizeZ);
+    snowParticles.setWind(snowWind);
+    Random snowRandom(sceneSeed, Random::snowStream);
+    std::vector<float> snowX(amountOfSnow), snowY(amountOfSnow), snowZ(amountOfSnow);
+    snowRandom.fillBetween(snowX.data(), amountOfSnow, -planeSizeX, planeSizeX);
+    snowRandom.fillBetween(snowY.data(), amountOfSnow, 0, 5);
+    snowRandom.fillBetween(snowZ.data(), amountOfSnow, -planeSizeZ, planeSizeZ);
     for(int i = 0; i < amountOfSnow; i++)
     {
-        snow[i].init(window,
-            glm::vec3(randomBetween(-planeSizeX,planeSizeX), randomBetween(0, 5), randomBetween(-planeSizeZ, planeSizeZ)),  //position in non-modelspace
+        glm::vec3 snowPosition(snowX[i], snowY[i], snowZ[i]);
+        snowParticles.add(snowPosition);
+        snow.add(
+            snowPosition,                                                                                                   //position in non-modelspace
             glm::scale(glm::vec3(0.02, 0.02, 0.02)),                                                                        //scale in non-modelspace
             glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),                                                            //rotation in non-modelspace
             glm::vec3(0.9, 0.9, 0.9)                                                                                        //color value
         );  
     }
+    StartupProfiler::end();
+    StartupProfiler::begin("ground + moon");
     ground.init(window,
         glm::vec3(0, 0, 0),                     //position in non-modelspace
         glm::scale(glm::vec3(2*planeSizeX, 0.1, 2*planeSizeZ)),     //scale in non-modelspace
@@ -340,11 +840,54 @@ int main() {
         glm::rotate(glm::radians(0.0f), glm::vec3(1, 0, 0)),        //rotation in non-modelspace
         glm::vec3(0.678, 0.847, 0.902)        
     );
+    StartupProfiler::end();
+
+    if(forestBatching)
+    {
+        StartupProfiler::begin("forest batch");
+        if(!forest.init(2*numTrees))
+        {
+            std::cout << "Drawing the forest one tree at a time" << std::endl;
+            forestBatching = false;
+        }
+        StartupProfiler::end();
+    }
+
+    // Everything that can be culled gets a box, the tree over them is only refit after this
+    StartupProfiler::begin("culling BVH");
+    for(int i = 0; i < numTrees; i++)
+    {
+        cullObjects.push_back(&leaves[i]);
+        cullBounds.push_back(leaves[i].getBounds());
+    }
+    for(int i = 0; i < numTrees; i++)
+    {
+        cullObjects.push_back(&trunks[i]);
+        cullBounds.push_back(trunks[i].getBounds());
+    }
+    cullObjects.push_back(&ground);
+    cullBounds.push_back(ground.getBounds());
+    cullObjects.push_back(&moon);
+    cullBounds.push_back(moon.getBounds());
+    sceneBVH.build(cullBounds);
+    StartupProfiler::end();
 
     // variables for speed of object motion in scene
     float angle = 0.5;
     float snowSpeed = 0.6;
-    glm::vec3 tempPosition;
+
+    double lastStageReport = glfwGetTime();
+    double lastOverlay = lastStageReport;
+    int frame = 0;
+
+    StartupProfiler::finish();
+    StartupProfiler::report(std::cout);
+
+    // Setup above talked to OpenGL directly, so the state cache can't trust what it knows
+    GLStateCache::invalidate();
+
+    // Zones are only recorded and GPU-timed when something will show them
+    FrameProfiler::setEnabled(profileOverlay || !tracePath.empty());
 
     // Set callback functions for user input
     glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -362,12 +905,15 @@ int main() {
         // But getting input after frames are calculated might lead to significant 
         // input delay in the event that frames take a while to render
         glfwPollEvents();
+        FrameProfiler::beginFrame();
 
         // Clear the screen before drawing new things
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
         
         // get time since last frame
-        current = glfwGetTime();
+        // Headless runs step the scene by a fixed amount instead
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        current = headless ? start + headlessFrameTime : glfwGetTime();
         deltaTime = current-start;
         float deltaAngle = angle * deltaTime;
         float snowDistance = snowSpeed*deltaTime;
@@ -380,10 +926,11 @@ int main() {
             // Optionally output frametimes
             // std::cout << "New Frame in: " << deltaTime << std::endl;
             // Reset timer
-            start = glfwGetTime();
+            start = headless ? current : glfwGetTime();
             // Draw!
 
             // Update the camera's data based on user input
+            FrameProfiler::beginZone("camera");
             if(userCameraInput)
             {
                 camera.update();
@@ -393,46 +940,180 @@ int main() {
             // If the spinning view is active, rotate slowly
             else if(spinningView)
             {
-                viewMatrix = glm::lookAt(
-                    glm::vec3((float)cos(start*0.2)*15, 15, (float)sin(start*0.2)*15),
-                    glm::vec3(0, 0, 0),
-                    glm::vec3(0, 1, 0)
-                );
+                viewMatrix = spinningViewMatrix(start);
+            }
+            // Sent once here instead of with every draw
+            frameUniforms.update(viewMatrix, projectionMatrix, (float)start);
+            stageTimes.camera += FrameProfiler::endZone();
+
+            // Rotate trees and build every tree's matrices on the worker threads
+            FrameProfiler::beginZone("trees");
+            jobs.parallelFor(numTrees, 16, [deltaAngle](int begin, int end) {
+                for(int i = begin; i < end; i++)
+                {
+                    // rotate every tree that isn't the first one
+                    if(i != 0){
+                        leaves[i].rotate(deltaAngle, glm::vec3(0, 1, 0));
+                    }
+                    leaves[i].update(viewMatrix, projectionMatrix);
+                    trunks[i].update();
+                    cullBounds[i] = leaves[i].getBounds();
+                    cullBounds[numTrees + i] = trunks[i].getBounds();
+                }
+            });
+            stageTimes.trees += FrameProfiler::endZone();
+
+            // make snow fall, writing new positions straight into the instance buffer
+            // The buffer is mapped here on the GL thread, workers only write to memory
+            FrameProfiler::beginZone("snow", true);
+            GLfloat* snowPositions = snow.mapPositions();
+            if(snowPositions != NULL)
+            {
+                jobs.parallelFor(snowParticles.size(), 4096, [snowDistance, deltaTime, snowPositions](int begin, int end) {
+                    snowParticles.update(begin, end, snowDistance, deltaTime, snowPositions);
+                });
+                snow.unmapPositions();
             }
+            stageTimes.snow += FrameProfiler::endZone();
 
-            for(int i = 0; i < numTrees; i++)
+            // Find what the camera can see
+            FrameProfiler::beginZone("cull");
+            visibleObjects.clear();
+            if(frustumCulling)
             {
-                // rotate every tree that isn't the first one
-                if(i != 0){
-                    leaves[i].rotate(deltaAngle, glm::vec3(0, 1, 0));
+                sceneBVH.refit(cullBounds);
+                viewFrustum.setMatrix(projectionMatrix * viewMatrix);
+                sceneBVH.query(viewFrustum, cullBounds, visibleObjects);
+                // Back in scene order, so draws within a group happen in the same order as unculled
+                std::sort(visibleObjects.begin(), visibleObjects.end());
+            }
+            else
+            {
+                for(int i = 0; i < cullObjects.size(); i++)
+                {
+                    visibleObjects.push_back(i);
                 }
-                // draw leaves and trunks
-                leaves[i].draw(viewMatrix, projectionMatrix);
-                trunks[i].draw(viewMatrix, projectionMatrix);
             }
-            for(int i = 0; i < amountOfSnow; i++)
+            stageTimes.cull += FrameProfiler::endZone();
+            stageTimes.visibleObjects += visibleObjects.size();
+
+            // draw everything on this thread, grouped so state only changes when it has to
+            // Each group in the queue is timed on its own
+            FrameProfiler::beginZone("draw");
+            GLStateCache::resetCounts();
+            renderQueue.clear();
+            // Ground and moon never move, so this only builds their model matrices the first time
+            ground.update();
+            moon.update();
+            forest.clear();
+            for(int i = 0; i < visibleObjects.size(); i++)
             {
-                // make snow fall
-                tempPosition = snow[i].getPosition();
-                tempPosition = glm::vec3(tempPosition.x, (tempPosition.y-snowDistance), tempPosition.z);
-                if(tempPosition.y < 0)
+                // draw visible leaves, trunks, ground and moon
+                // Leaves and trunks go in the forest batch if it's on
+                int object = visibleObjects[i];
+                if(forestBatching && object < numTrees)
+                {
+                    forest.add(leaves[object]);
+                }
+                else if(forestBatching && object < 2*numTrees)
+                {
+                    forest.add(trunks[object - numTrees]);
+                }
+                else
+                {
+                    cullObjects[object]->submit(renderQueue);
+                }
+                if(object < numTrees)
                 {
-                    tempPosition = tempPosition + glm::vec3(0, 5, 0);
+                    stageTimes.leafTetrahedra += sierpinskiTetrahedronCount(leaves[object].getDrawnLevel());
                 }
-                snow[i].setPosition(tempPosition);
-                // draw snow
-                snow[i].draw(viewMatrix, projectionMatrix);
             }
-            ground.draw(viewMatrix, projectionMatrix);
-            moon.draw(viewMatrix, projectionMatrix);
+            if(forestBatching)
+            {
+                forest.submit(renderQueue);
+                stageTimes.forestDraws += forest.getDrawCount();
+            }
+            // draw snow
+            snow.submit(renderQueue);
+            renderQueue.draw();
+            stageTimes.draw += FrameProfiler::endZone();
+            stageTimes.stateCallsIssued += GLStateCache::getIssued();
+            stageTimes.stateCallsSkipped += GLStateCache::getSkipped();
+            stageTimes.drawCalls += GLStateCache::getDraws();
+            stageTimes.frames++;
 
-            // actually draw created frame to screen
-            glfwSwapBuffers(window);    
+            // Print average stage times every few seconds
+            if(!headless && start - lastStageReport > stageReportInterval)
+            {
+                std::cout << jobs.getThreadCount() << " thread(s), avg ms per frame:"
+                    << " camera " << stageTimes.camera/stageTimes.frames
+                    << " trees " << stageTimes.trees/stageTimes.frames
+                    << " snow " << stageTimes.snow/stageTimes.frames
+                    << " cull " << stageTimes.cull/stageTimes.frames
+                    << " draw " << stageTimes.draw/stageTimes.frames
+                    << ", visible objects " << stageTimes.visibleObjects/stageTimes.frames << "/" << cullObjects.size()
+                    << ", leaf tetrahedra " << stageTimes.leafTetrahedra/stageTimes.frames
+                    << ", gl state calls issued " << stageTimes.stateCallsIssued/stageTimes.frames
+                    << " skipped " << stageTimes.stateCallsSkipped/stageTimes.frames
+                    << ", draw calls " << stageTimes.drawCalls/stageTimes.frames << std::endl;
+                stageTimes = StageTimes();
+                lastStageReport = start;
+            }
+
+            // Show the profiler's per-stage averages, GPU times arrive a few frames late
+            if(profileOverlay && start - lastOverlay > overlayInterval)
+            {
+                if(headless)
+                {
+                    std::cout << FrameProfiler::getSummary() << std::endl;
+                }
+                else
+                {
+                    glfwSetWindowTitle(window, (std::string(windowTitle) + " | " + FrameProfiler::getSummary()).c_str());
+                }
+                lastOverlay = start;
+            }
+
+            if(headless)
+            {
+                // Everything up to here was CPU work, glFinish waits for the GPU to catch up
+                double cpuTime = msSince(frameStart);
+                std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+                glFinish();
+                double gpuWait = msSince(waitStart);
+                if(frame >= headlessWarmupFrames)
+                {
+                    frameStats.addFrame(cpuTime, gpuWait);
+                }
+                else
+                {
+                    // Stage times only cover the timed frames
+                    stageTimes = StageTimes();
+                }
+            }
+            else
+            {
+                // actually draw created frame to screen
+                glfwSwapBuffers(window);    
+            }
+            FrameProfiler::endFrame();
+            frame++;
         }
 
-    } // Check if the ESC key was pressed or the window was closed
-    while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
-        glfwWindowShouldClose(window) == 0);
-    
-    return 0;
+    } // Headless runs stop after their frames, otherwise check if the ESC key was pressed or the window was closed
+    while( headless ? frame < headlessWarmupFrames + headlessFrames :
+        (glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
+        glfwWindowShouldClose(window) == 0));
+
+    int result = 0;
+    if(headless && !writeHeadlessReport(frameStats))
+    {
+        result = -1;
+    }
+    if(!tracePath.empty() && !FrameProfiler::writeTrace(tracePath))
+    {
+        result = -1;
+    }
+    jobs.shutdown();
+    return result;
 }
\ No newline at end of file
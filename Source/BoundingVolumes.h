@@ -0,0 +1,255 @@
+#ifndef BOUNDINGVOLUMES_H
+#define BOUNDINGVOLUMES_H
+
+//General includes
+#include <vector>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+//Opengl includes
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct AABB {
+    AABB()
+    {
+        min = glm::vec3(FLT_MAX);
+        max = glm::vec3(-FLT_MAX);
+    }
+    AABB(const glm::vec3 &minCorner, const glm::vec3 &maxCorner)
+    {
+        min = minCorner;
+        max = maxCorner;
+    }
+    glm::vec3 min, max;
+    glm::vec3 getCenter() const
+    {
+        return (min + max)*0.5f;
+    }
+    glm::vec3 getExtent() const
+    {
+        return (max - min)*0.5f;
+    }
+    void expand(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void expand(const AABB &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    // Grows every side by the same amount
+    void pad(float amount)
+    {
+        min -= glm::vec3(amount);
+        max += glm::vec3(amount);
+    }
+    // Smallest box around this one after a transform (Arvo's method)
+    // Only the center is transformed, the extent is grown by the size of the rotation/scale
+    AABB transformed(const glm::mat4 &matrix) const
+    {
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1));
+        glm::vec3 extent = getExtent();
+        glm::vec3 newExtent(0);
+        for(int row = 0; row < 3; row++)
+        {
+            for(int col = 0; col < 3; col++)
+            {
+                newExtent[row] += fabsf(matrix[col][row]) * extent[col];
+            }
+        }
+        return AABB(center - newExtent, center + newExtent);
+    }
+};
+
+// The six planes of a view/projection matrix, normals point inwards
+class Frustum {
+    public:
+        enum Result {
+            Outside,
+            Intersecting,
+            Inside
+        };
+        // Extracts the planes from projection * view (Gribb/Hartmann)
+        void setMatrix(const glm::mat4 &viewProjection)
+        {
+            glm::vec4 rows[4];
+            for(int i = 0; i < 4; i++)
+            {
+                rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            }
+            planes[0] = rows[3] + rows[0];     //left
+            planes[1] = rows[3] - rows[0];     //right
+            planes[2] = rows[3] + rows[1];     //bottom
+            planes[3] = rows[3] - rows[1];     //top
+            planes[4] = rows[3] + rows[2];     //near
+            planes[5] = rows[3] - rows[2];     //far
+        }
+        // Whether a box is completely outside, completely inside, or crossing a plane
+        // Only signs are compared, so the planes don't have to be normalized
+        Result test(const AABB &box) const
+        {
+            glm::vec3 center = box.getCenter();
+            glm::vec3 extent = box.getExtent();
+            Result result = Inside;
+            for(int i = 0; i < 6; i++)
+            {
+                glm::vec3 normal = glm::vec3(planes[i]);
+                float distance = glm::dot(normal, center) + planes[i].w;
+                float radius = glm::dot(glm::abs(normal), extent);
+                if(distance + radius < 0)
+                {
+                    return Outside;
+                }
+                if(distance - radius < 0)
+                {
+                    result = Intersecting;
+                }
+            }
+            return result;
+        }
+    private:
+        glm::vec4 planes[6];
+};
+
+// Bounding volume hierarchy over a fixed set of objects, each with a box
+// Built once with a median split on the longest axis, then refit every frame
+// as objects move. Objects that move a long way make the tree loose (slower
+// to query) but never wrong, so build() again if the scene changes a lot.
+class BoundingVolumeHierarchy {
+    public:
+        // Builds the tree for these boxes, object i is bounds[i]
+        void build(const std::vector<AABB> &bounds)
+        {
+            nodes.clear();
+            objects.resize(bounds.size());
+            for(int i = 0; i < objects.size(); i++)
+            {
+                objects[i] = i;
+            }
+            if(!objects.empty())
+            {
+                buildNode(bounds, 0, objects.size());
+            }
+        }
+        // Updates every node's box for the objects' new boxes, the tree itself stays the same
+        void refit(const std::vector<AABB> &bounds)
+        {
+            // Children are always stored after their parent
+            for(int i = nodes.size()-1; i >= 0; i--)
+            {
+                Node &node = nodes[i];
+                node.bounds = AABB();
+                if(node.left < 0)
+                {
+                    for(int j = node.first; j < node.first + node.count; j++)
+                    {
+                        node.bounds.expand(bounds[objects[j]]);
+                    }
+                }
+                else
+                {
+                    node.bounds.expand(nodes[node.left].bounds);
+                    node.bounds.expand(nodes[node.right].bounds);
+                }
+            }
+        }
+        // Adds the index of every object whose box is at least partly in the frustum
+        // bounds should be the boxes from the last refit(), objects come out in tree order
+        void query(const Frustum &frustum, const std::vector<AABB> &bounds, std::vector<int> &visible) const
+        {
+            if(nodes.empty())
+            {
+                return;
+            }
+            std::vector<int> &stack = queryStack;
+            stack.clear();
+            stack.push_back(0);
+            while(!stack.empty())
+            {
+                const Node &node = nodes[stack.back()];
+                stack.pop_back();
+                Frustum::Result result = frustum.test(node.bounds);
+                if(result == Frustum::Outside)
+                {
+                    continue;
+                }
+                // Everything under a node that's fully inside is visible, no need to test further
+                if(result == Frustum::Inside)
+                {
+                    visible.insert(visible.end(), objects.begin() + node.first, objects.begin() + node.first + node.count);
+                    continue;
+                }
+                // Leaves crossing the frustum test each of their objects
+                if(node.left < 0)
+                {
+                    for(int j = node.first; j < node.first + node.count; j++)
+                    {
+                        if(frustum.test(bounds[objects[j]]) != Frustum::Outside)
+                        {
+                            visible.push_back(objects[j]);
+                        }
+                    }
+                    continue;
+                }
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            }
+        }
+        int getObjectCount() const
+        {
+            return objects.size();
+        }
+    private:
+        static const int maxLeafSize = 4;
+        struct Node {
+            AABB bounds;
+            int left, right;        // child nodes, -1 for leaves
+            int first, count;       // range of objects under this node
+        };
+        std::vector<Node> nodes;    // nodes[0] is the root
+        std::vector<int> objects;   // object indices, every node's objects are contiguous
+        mutable std::vector<int> queryStack;
+        int buildNode(const std::vector<AABB> &bounds, int first, int count)
+        {
+            int index = nodes.size();
+            nodes.push_back(Node());
+            nodes[index].first = first;
+            nodes[index].count = count;
+            nodes[index].left = -1;
+            nodes[index].right = -1;
+            for(int j = first; j < first + count; j++)
+            {
+                nodes[index].bounds.expand(bounds[objects[j]]);
+            }
+            if(count <= maxLeafSize)
+            {
+                return index;
+            }
+
+            // Split at the median object along the longest axis of their centers
+            AABB centers;
+            for(int j = first; j < first + count; j++)
+            {
+                centers.expand(bounds[objects[j]].getCenter());
+            }
+            glm::vec3 size = centers.max - centers.min;
+            int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+            int half = count/2;
+            std::nth_element(objects.begin() + first, objects.begin() + first + half, objects.begin() + first + count,
+                [&bounds, axis](int a, int b) {
+                    return bounds[a].getCenter()[axis] < bounds[b].getCenter()[axis];
+                });
+
+            int left = buildNode(bounds, first, half);
+            int right = buildNode(bounds, first + half, count - half);
+            nodes[index].left = left;
+            nodes[index].right = right;
+            return index;
+        }
+};
+
+#endif
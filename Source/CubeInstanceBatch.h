@@ -0,0 +1,343 @@
+#ifndef CUBEINSTANCEBATCH_H
+#define CUBEINSTANCEBATCH_H
+
+//General includes
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+//Opengl includes
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+
+//Project-specific includes
+#include "LoadShaders.h"
+#include "Primitives.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "StartupProfiler.h"
+#include "FrameUniforms.h"
+
+// A lot of identical cubes drawn with a single instanced draw call
+// Each instance has its own position, scale/rotation and color.
+// Positions live in their own buffer since they're the only thing that
+// changes every frame; the rest is uploaded only when instances are added.
+class CubeInstanceBatch : public Renderable {
+    public:
+        CubeInstanceBatch(){}
+        void init(GLFWwindow* window, int maxInstances)
+        {
+            // Data initialization
+            renderFaces = true;
+            renderWireframe = true;
+            capacity = maxInstances;
+            positionsDirty = false;
+            attributesDirty = false;
+            positions.reserve(capacity);
+            scaleRotations.reserve(capacity);
+            colors.reserve(capacity);
+
+            // Load and compile shaders
+            // The geometry stage only passes triangles through, so it's left out unless asked for
+            if(useGeometryShader())
+            {
+                batchShader = LoadShaders("instancedCube.vrt.glsl", "passthrough.geo.glsl", "colorShader.frg.glsl");
+            }
+            else
+            {
+                batchShader = LoadShaders("instancedCube.vrt.glsl", "colorShader.frg.glsl");
+            }
+            glUseProgram(batchShader);
+
+            // View and projection come from the frame's uniform buffer
+            FrameUniforms::bindProgram(batchShader);
+
+            // initialize wireframe color reference in shaders
+            wireframeColorRef = glGetUniformLocation(batchShader, "wireframeColor");
+            if(wireframeColorRef < 0)
+            {   std::cerr<< "couldn't find wireframeColor in shader\n"; }
+
+            // initialize colorType reference in shaders
+            colorTypeRef = glGetUniformLocation(batchShader, "colorType");
+            if(colorTypeRef < 0)
+            {   std::cerr<< "couldn't find colorType in shader\n"; }
+
+            //Generate VAO for this batch
+            // It records every attribute and divisor, so drawing only has to bind it
+            glGenVertexArrays(1, &vao);
+            GLStateCache::bindVertexArray(vao);
+
+            // Generate cube and per-instance buffers
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &instancePositionBuffer);
+            glGenBuffers(1, &instanceScaleRotationBuffer);
+            glGenBuffers(1, &instanceColorBuffer);
+
+            setCubeBufferData();
+
+            // Allocate per-instance storage once, filled in as instances are added
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instancePositionBuffer);
+            glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceScaleRotationBuffer);
+            glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(glm::mat3), NULL, GL_STATIC_DRAW);
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceColorBuffer);
+            glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+
+            setVertexArray();
+        }
+        // Adds a cube to the batch, returns its index or -1 if the batch is full
+        int add(glm::vec3 position, glm::mat4 scale, glm::mat4 rotation, glm::vec3 color)
+        {
+            if(size() >= capacity)
+            {
+                std::cerr << "CubeInstanceBatch is full (" << capacity << " cubes)\n";
+                return -1;
+            }
+            positions.push_back(position);
+            scaleRotations.push_back(glm::mat3(rotation * scale));
+            colors.push_back(color);
+            positionsDirty = true;
+            attributesDirty = true;
+            return size()-1;
+        }
+        // draw function
+        // Draws every cube in the batch with one instanced draw per render mode
+        void draw()
+        {
+            if(positions.empty())
+            {
+                return;
+            }
+
+            // Send any changed instance data to the graphics card
+            uploadInstanceData();
+
+            // draw triangle faces and/or wireframe, in one pass if single-pass wireframe is on
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                drawPass(passes[i]);
+            }
+        }
+        // Queues this frame's passes instead of drawing them right away
+        void submit(RenderQueue &queue)
+        {
+            if(positions.empty())
+            {
+                return;
+            }
+            // Send any changed instance data to the graphics card
+            uploadInstanceData();
+
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                queue.add(batchShader, passes[i], this);
+            }
+        }
+        // Draws a single pass for every cube, only state that differs from the last draw is sent
+        void drawPass(RenderPass pass)
+        {
+            // Use shader for the batch
+            GLStateCache::useProgram(batchShader);
+
+            // cull backfaces, but draw the whole wireframe, back edges included in the single pass too
+            GLStateCache::setEnabled(GL_CULL_FACE, pass == FacesPass);
+            setRenderPassState(pass);
+
+            // The batch's VAO has the cube and the per-instance attributes
+            GLStateCache::bindVertexArray(vao);
+
+            // Set wireframe color
+            glUniform3fv(wireframeColorRef, 1, glm::value_ptr(wireframeColor));
+
+            // Send colorType to shader, 1 for faces, 0 for wireframe and 2 for both
+            glUniform1i(colorTypeRef, getColorType(pass));
+
+            glDrawArraysInstanced(
+                GL_TRIANGLES,
+                0,
+                36,     //6 quads * 2 triangles per quad * 3 vertices per triangle
+                positions.size()
+            );
+            GLStateCache::countDraws(1);
+        }
+        const char* getProfileName(RenderPass pass)
+        {
+            const char* names[renderPassCount] = { "snow batch", "snow batch wireframe", "snow batch + wireframe" };
+            return names[pass];
+        }
+        //  Toggle wireframe/faces on and off
+        void toggleWireframe()
+        {
+            renderWireframe = !renderWireframe;
+        }
+        void toggleFaces()
+        {
+            renderFaces = !renderFaces;
+        }
+        // Only draw as wireframe/faces
+        void drawAsWireframe()
+        {
+            renderFaces = false;
+            renderWireframe = true;
+        }
+        void drawAsFaces()
+        {
+            renderFaces = true;
+            renderWireframe = false;
+        }
+        // Moves a single cube, uploaded on the next draw
+        void setPosition(int index, const glm::vec3 &position)
+        {
+            positions[index] = position;
+            positionsDirty = true;
+        }
+        // Maps the instance position buffer so xyz triples can be written straight into it
+        // Whatever is written replaces positions given to add() or setPosition(),
+        // which are not updated to match. Returns NULL for an empty batch.
+        GLfloat* mapPositions()
+        {
+            if(positions.empty())
+            {
+                return NULL;
+            }
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instancePositionBuffer);
+            return (GLfloat*)glMapBufferRange(
+                GL_ARRAY_BUFFER,
+                0,
+                positions.size()*sizeof(glm::vec3),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+            );
+        }
+        void unmapPositions()
+        {
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instancePositionBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            // The buffer now holds the newest positions
+            positionsDirty = false;
+        }
+        // returns xyz position of a cube in worldspace
+        glm::vec3 getPosition(int index)
+        {
+            return positions[index];
+        }
+        int size()
+        {
+            return positions.size();
+        }
+        int getCapacity()
+        {
+            return capacity;
+        }
+        // Batches initialized after this go through passthrough.geo.glsl, only kept to benchmark against
+        static void setGeometryShaderPath(bool enabled)
+        {
+            useGeometryShader() = enabled;
+        }
+    private:
+        static bool &useGeometryShader()
+        {
+            static bool enabled = false;
+            return enabled;
+        }
+        GLuint batchShader, vao, vertexBuffer;
+        GLuint instancePositionBuffer, instanceScaleRotationBuffer, instanceColorBuffer;
+        GLint wireframeColorRef, colorTypeRef;     //glUniform location references for shader
+        glm::vec3 wireframeColor = glm::vec3(1.0, 1.0, 1.0);    //Color for the wireframe
+        std::vector<glm::vec3> positions;           //per-instance xyz position in worldspace
+        std::vector<glm::mat3> scaleRotations;      //per-instance rotation * scale
+        std::vector<glm::vec3> colors;              //per-instance color
+        int capacity;
+        bool positionsDirty, attributesDirty;       //instance data changed since the last upload
+        bool renderFaces, renderWireframe;
+
+        // Uploads whichever instance data changed since the last draw
+        void uploadInstanceData()
+        {
+            if(positionsDirty)
+            {
+                GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instancePositionBuffer);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size()*sizeof(glm::vec3), &positions[0]);
+                positionsDirty = false;
+            }
+            if(attributesDirty)
+            {
+                GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceScaleRotationBuffer);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, scaleRotations.size()*sizeof(glm::mat3), &scaleRotations[0]);
+                GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceColorBuffer);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, colors.size()*sizeof(glm::vec3), &colors[0]);
+                attributesDirty = false;
+            }
+        }
+        // Records the cube and per-instance attributes in the VAO
+        // Divisors are VAO state too, so they never leak into other objects
+        void setVertexArray()
+        {
+            // Cube vertex positions, same for every instance
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+            // Per-instance position
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instancePositionBuffer);
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            glVertexAttribDivisor(2, 1);
+
+            // Per-instance scale/rotation, a mat3 takes one attribute per column
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceScaleRotationBuffer);
+            for(int i = 0; i < 3; i++)
+            {
+                glEnableVertexAttribArray(3+i);
+                glVertexAttribPointer(3+i, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(i*sizeof(glm::vec3)));
+                glVertexAttribDivisor(3+i, 1);
+            }
+
+            // Per-instance color
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceColorBuffer);
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            glVertexAttribDivisor(6, 1);
+        }
+        // Sets cube vertex data, shared by every instance
+        // Every face has its own three vertices, like IBOCube
+        void setCubeBufferData()
+        {
+            // Same cube as IBOCube
+            GLfloat cubeVerts[24] = {
+                -0.5, -0.5, -0.5,
+                0.5, -0.5, -0.5,
+                0.5, 0.5, -0.5,
+                -0.5, 0.5, -0.5,
+                -0.5, -0.5, 0.5,
+                -0.5, 0.5, 0.5,
+                0.5, 0.5, 0.5,
+                0.5, -0.5, 0.5
+            };
+            GLfloat vertexData[36*3];
+            Cube cube = Cube(0, 1, 2, 3, 4, 5, 6, 7);
+            for(int i = 0; i < 12; i++)     //6 quads * 2 triangles per quad
+            {
+                const glm::ivec3 &face = cube.quads[i/2].faces[i%2];
+                int corners[3] = { face.x, face.y, face.z };
+                for(int k = 0; k < 3; k++)
+                {
+                    vertexData[(i*3 + k)*3 + 0] = cubeVerts[corners[k]*3 + 0];
+                    vertexData[(i*3 + k)*3 + 1] = cubeVerts[corners[k]*3 + 1];
+                    vertexData[(i*3 + k)*3 + 2] = cubeVerts[corners[k]*3 + 2];
+                }
+            }
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+            StartupProfiler::count("bytes uploaded", sizeof(vertexData));
+        }
+};
+
+#endif
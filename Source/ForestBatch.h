@@ -0,0 +1,565 @@
+#ifndef FORESTBATCH_H
+#define FORESTBATCH_H
+
+//General includes
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+//Opengl includes
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+//Project-specific includes
+#include "LoadShaders.h"
+#include "Primitives.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "FrameUniforms.h"
+#include "SierpinskiPyramid.h"
+#include "IBOCube.h"
+
+// Draws every visible leaf and trunk with a fixed number of draw calls
+// All tree meshes live in one vertex buffer: the trunk cube, then each leaf
+// level as it's first drawn, copied on the GPU from the geometry cache's buffer.
+// Per-object matrices and tint go in a buffer texture, one slot per instance,
+// and each instance finds its slot through an instanced attribute.
+// Leaves are drawn with one glMultiDrawArraysIndirect per pass when GL 4.3 (or
+// ARB_multi_draw_indirect + ARB_base_instance) is there, otherwise with one
+// instanced draw per leaf level. Trunks are always one instanced draw per pass.
+// Objects are added again every frame after culling; GL thread only.
+// The batch never keeps a leaf level alive: once no pyramid draws a level,
+// its place in the buffer is reclaimed by packing the live meshes together.
+class ForestBatch : public Renderable {
+    public:
+        ForestBatch(){}
+        // maxObjects is the most leaves plus trunks that will be added in a frame
+        // Returns false if that many objects don't fit in a buffer texture here
+        bool init(int maxObjects)
+        {
+            GLint maxTexels = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+            if((long long)2*maxObjects*texelsPerObject > maxTexels)
+            {
+                std::cerr << "couldn't fit " << maxObjects << " objects in a buffer texture of " << maxTexels << " texels" << std::endl;
+                return false;
+            }
+            capacity = maxObjects;
+            vertexCapacity = 0;
+            vertexCount = 0;
+            deadVertices = 0;
+            multiDrawIndirect = allowMultiDrawIndirect() &&
+                (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance));
+
+            // Load and compile shaders
+            // Same vertex shader for both, leaves breathe and color wireframes by normal
+            leafShader = LoadShaders("forest.vrt.glsl", "breathingShader.frg.glsl");
+            trunkShader = LoadShaders("forest.vrt.glsl", "colorShader.frg.glsl");
+            initShader(leafShader, 1.0f, leafRefs);
+            initShader(trunkShader, 0.0f, trunkRefs);
+
+            // initialize wireframe color reference in shaders
+            GLint wireframeColorRef = glGetUniformLocation(trunkShader, "wireframeColor");
+            if(wireframeColorRef < 0)
+            {   std::cerr<< "couldn't find wireframeColor in shader\n"; }
+            glUniform3fv(wireframeColorRef, 1, glm::value_ptr(wireframeColor));
+
+            //Generate VAO for the forest
+            glGenVertexArrays(1, &vao);
+            GLStateCache::bindVertexArray(vao);
+
+            // Every instance of both passes gets its own slot
+            // The vertex buffer is created by growVertexBuffer() below
+            vertexBuffer = 0;
+            glGenBuffers(1, &objectIndexBuffer);
+            glGenBuffers(1, &objectBuffer);
+            glGenBuffers(1, &indirectBuffer);
+            glGenTextures(1, &objectTexture);
+
+            // Slot numbers 0, 1, 2... read once per instance, offset by each draw's base instance
+            std::vector<GLint> objectIndices(2*capacity);
+            for(int i = 0; i < objectIndices.size(); i++)
+            {
+                objectIndices[i] = i;
+            }
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, objectIndices.size()*sizeof(GLint), &objectIndices[0], GL_STATIC_DRAW);
+            StartupProfiler::count("bytes uploaded", objectIndices.size()*sizeof(GLint));
+            glEnableVertexAttribArray(3);
+            glVertexAttribIPointer(3, 1, GL_INT, 0, (void*)0);
+            glVertexAttribDivisor(3, 1);
+
+            // Per-object data is refilled every frame, the texture just points at the buffer
+            GLStateCache::bindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, 2*capacity*texelsPerObject*sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, objectTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, objectBuffer);
+
+            // Trunk cube goes first, leaf levels are added after it as they're drawn
+            growVertexBuffer(initialVertexCapacity);
+            setTrunkVertexData();
+            return true;
+        }
+        // Drops last frame's objects, and the meshes of levels nothing draws anymore
+        void clear()
+        {
+            for(int pass = 0; pass < renderPassCount; pass++)
+            {
+                leaves[pass].clear();
+                trunks[pass].clear();
+            }
+            releaseDeadRegions();
+        }
+        // Adds a leaf for every pass it draws, with its matrices from the last update()
+        void add(SierpinskiPyramid &leaf)
+        {
+            const std::shared_ptr<SierpinskiGeometry> &geometry = leaf.getDrawnGeometry();
+            Instance instance;
+            instance.first = getMeshFirst(geometry);
+            instance.count = geometry->getVertexCount();
+            instance.modelMatrix = leaf.getModelMatrix();
+            instance.normalMatrix = leaf.getNormalMatrix();
+            instance.tint = glm::vec3(1, 1, 1);
+            addInstance(leaves, instance, leaf);
+        }
+        // Adds a trunk for every pass it draws, with its matrix from the last update()
+        void add(IBOCube &trunk)
+        {
+            Instance instance;
+            instance.first = trunkFirst;
+            instance.count = 36;
+            instance.modelMatrix = trunk.getModelMatrix();
+            instance.normalMatrix = glm::mat3(glm::transpose(glm::inverse(instance.modelMatrix)));
+            instance.tint = trunk.getColor();
+            addInstance(trunks, instance, trunk);
+        }
+        // Uploads this frame's objects and draw commands, then queues a draw for each pass
+        void submit(RenderQueue &queue)
+        {
+            upload();
+            for(int pass = 0; pass < renderPassCount; pass++)
+            {
+                if(!leaves[pass].empty() || !trunks[pass].empty())
+                {
+                    queue.add(leafShader, (RenderPass)pass, this);
+                }
+            }
+        }
+        // Draws every leaf, then every trunk, for one pass
+        void drawPass(RenderPass pass)
+        {
+            GLStateCache::bindVertexArray(vao);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, objectTexture);
+
+            const PassDraws &draws = passDraws[pass];
+            if(!draws.leafCommands.empty())
+            {
+                GLStateCache::useProgram(leafShader);
+                // Pyramids are never culled
+                GLStateCache::setEnabled(GL_CULL_FACE, false);
+                setRenderPassState(pass);
+                glUniform1i(leafRefs.colorType, getColorType(pass));
+                if(multiDrawIndirect)
+                {
+                    // Every level in one call, each command's base instance picks its slots
+                    glUniform1i(leafRefs.instanceOffset, 0);
+                    GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+                    glMultiDrawArraysIndirect(
+                        GL_TRIANGLES,
+                        (void*)(draws.firstCommand*sizeof(DrawCommand)),
+                        draws.leafCommands.size(),
+                        0
+                    );
+                    GLStateCache::countDraws(1);
+                }
+                else
+                {
+                    for(int i = 0; i < draws.leafCommands.size(); i++)
+                    {
+                        const DrawCommand &command = draws.leafCommands[i];
+                        glUniform1i(leafRefs.instanceOffset, command.baseInstance);
+                        glDrawArraysInstanced(GL_TRIANGLES, command.first, command.count, command.instanceCount);
+                    }
+                    GLStateCache::countDraws(draws.leafCommands.size());
+                }
+            }
+            if(draws.trunkCount > 0)
+            {
+                GLStateCache::useProgram(trunkShader);
+                // cull backfaces, but draw the whole wireframe, back edges included in the single pass too
+                GLStateCache::setEnabled(GL_CULL_FACE, pass == FacesPass);
+                setRenderPassState(pass);
+                glUniform1i(trunkRefs.colorType, getColorType(pass));
+                glUniform1i(trunkRefs.instanceOffset, draws.firstTrunk);
+                glDrawArraysInstanced(GL_TRIANGLES, trunkFirst, 36, draws.trunkCount);
+                GLStateCache::countDraws(1);
+            }
+        }
+        const char* getProfileName(RenderPass pass)
+        {
+            const char* names[renderPassCount] = { "forest", "forest wireframe", "forest + wireframe" };
+            return names[pass];
+        }
+        // Draw calls the last submit() queued, leaves and trunks for every pass
+        int getDrawCount()
+        {
+            int count = 0;
+            for(int pass = 0; pass < renderPassCount; pass++)
+            {
+                if(!passDraws[pass].leafCommands.empty())
+                {
+                    count += multiDrawIndirect ? 1 : passDraws[pass].leafCommands.size();
+                }
+                if(passDraws[pass].trunkCount > 0)
+                {
+                    count++;
+                }
+            }
+            return count;
+        }
+        bool usesMultiDrawIndirect()
+        {
+            return multiDrawIndirect;
+        }
+        // Batches initialized after this use an instanced draw per leaf level even if
+        // multi-draw indirect is there, to compare the two
+        static void setMultiDrawIndirectAllowed(bool allowed)
+        {
+            allowMultiDrawIndirect() = allowed;
+        }
+    private:
+        static const int texelsPerObject = 8;      // model matrix, normal matrix padded to vec4s, tint
+        static const int initialVertexCapacity = 1 << 16;
+        // Layout glMultiDrawArraysIndirect reads
+        struct DrawCommand {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint first;
+            GLuint baseInstance;
+        };
+        struct Instance {
+            int first, count;       // vertices of its mesh in the shared buffer
+            glm::mat4 modelMatrix;
+            glm::mat3 normalMatrix;
+            glm::vec3 tint;         // multiplies the mesh's vertex colors
+            bool operator<(const Instance &other) const
+            {
+                return first < other.first;
+            }
+        };
+        struct ShaderRefs {
+            GLint instanceOffset, colorType;
+        };
+        // Where each pass's draws start once this frame's objects are uploaded
+        struct PassDraws {
+            std::vector<DrawCommand> leafCommands;
+            int firstCommand;       // leafCommands' position in the indirect buffer
+            int firstTrunk, trunkCount;
+        };
+        // A leaf mesh's place in the shared buffer
+        // Only a weak reference, so the forest doesn't keep a level alive after its last pyramid moves off it.
+        // Once it expires a new geometry can have the same address, so an expired region never matches.
+        struct MeshRegion {
+            std::weak_ptr<SierpinskiGeometry> geometry;
+            int first, count;
+        };
+        static bool &allowMultiDrawIndirect()
+        {
+            static bool allowed = true;
+            return allowed;
+        }
+        GLuint leafShader, trunkShader, vao;
+        GLuint vertexBuffer, objectIndexBuffer, objectBuffer, objectTexture, indirectBuffer;
+        ShaderRefs leafRefs, trunkRefs;
+        glm::vec3 wireframeColor = glm::vec3(1.0, 1.0, 1.0);    //Color for the trunk wireframe
+        int capacity;
+        int vertexCapacity, vertexCount;    // in vertices, SierpinskiGeometry's layout
+        int deadVertices;                   // vertices of released meshes still taking up space
+        int trunkFirst;
+        bool multiDrawIndirect;
+        std::map<const SierpinskiGeometry*, MeshRegion> meshRegions;
+        std::vector<Instance> leaves[renderPassCount], trunks[renderPassCount];    // this frame's objects, by pass
+        PassDraws passDraws[renderPassCount];
+        std::vector<glm::vec4> objectData;
+        std::vector<DrawCommand> commands;
+
+        void initShader(GLuint shader, float breathing, ShaderRefs &refs)
+        {
+            glUseProgram(shader);
+
+            // View, projection and the breathing timer come from the frame's uniform buffer
+            FrameUniforms::bindProgram(shader);
+
+            // Per-object data is always read from texture unit 0
+            GLint objectDataRef = glGetUniformLocation(shader, "objectData");
+            if(objectDataRef < 0)
+            {   std::cerr << "couldn't find objectData in shader\n";  }
+            glUniform1i(objectDataRef, 0);
+
+            // initialize breathing reference in shaders, it never changes
+            GLint breathingRef = glGetUniformLocation(shader, "breathing");
+            if(breathingRef < 0)
+            {   std::cerr << "couldn't find breathing in shader\n";  }
+            glUniform1f(breathingRef, breathing);
+
+            // initialize instanceOffset reference in shaders
+            refs.instanceOffset = glGetUniformLocation(shader, "instanceOffset");
+            if(refs.instanceOffset < 0)
+            {   std::cerr << "couldn't find instanceOffset in shader\n";  }
+
+            // initialize colorType reference in shaders
+            refs.colorType = glGetUniformLocation(shader, "colorType");
+            if(refs.colorType < 0)
+            {   std::cerr<< "couldn't find colorType in shader\n"; }
+        }
+        // Adds the instance to the list for every pass the object draws
+        template<typename Object>
+        void addInstance(std::vector<Instance>* instances, const Instance &instance, Object &object)
+        {
+            RenderPass passes[2];
+            int passCount = object.getPasses(passes);
+            int count = 0;
+            for(int pass = 0; pass < renderPassCount; pass++)
+            {
+                count += leaves[pass].size() + trunks[pass].size();
+            }
+            if(count + passCount > 2*capacity)
+            {
+                std::cerr << "ForestBatch is full (" << capacity << " objects)\n";
+                return;
+            }
+            for(int i = 0; i < passCount; i++)
+            {
+                instances[passes[i]].push_back(instance);
+            }
+        }
+        // Writes every object's slot and the leaves' draw commands, grouped by mesh
+        void upload()
+        {
+            objectData.clear();
+            commands.clear();
+            for(int pass = 0; pass < renderPassCount; pass++)
+            {
+                PassDraws &draws = passDraws[pass];
+                draws.leafCommands.clear();
+                draws.firstCommand = commands.size();
+
+                // Leaves sharing a mesh go next to each other so they're one instanced command
+                std::stable_sort(leaves[pass].begin(), leaves[pass].end());
+                for(int i = 0; i < leaves[pass].size(); i++)
+                {
+                    const Instance &instance = leaves[pass][i];
+                    if(draws.leafCommands.empty() || draws.leafCommands.back().first != instance.first)
+                    {
+                        DrawCommand command;
+                        command.count = instance.count;
+                        command.instanceCount = 0;
+                        command.first = instance.first;
+                        command.baseInstance = objectData.size()/texelsPerObject;
+                        draws.leafCommands.push_back(command);
+                    }
+                    draws.leafCommands.back().instanceCount++;
+                    writeObject(instance);
+                }
+                commands.insert(commands.end(), draws.leafCommands.begin(), draws.leafCommands.end());
+
+                draws.firstTrunk = objectData.size()/texelsPerObject;
+                draws.trunkCount = trunks[pass].size();
+                for(int i = 0; i < trunks[pass].size(); i++)
+                {
+                    writeObject(trunks[pass][i]);
+                }
+            }
+
+            // Whole new storage each frame, so last frame's draws never have to finish first
+            if(!objectData.empty())
+            {
+                GLStateCache::bindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+                glBufferData(GL_TEXTURE_BUFFER, 2*capacity*texelsPerObject*sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, objectData.size()*sizeof(glm::vec4), &objectData[0]);
+            }
+            if(multiDrawIndirect && !commands.empty())
+            {
+                GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size()*sizeof(DrawCommand), &commands[0], GL_STREAM_DRAW);
+            }
+        }
+        void writeObject(const Instance &instance)
+        {
+            for(int i = 0; i < 4; i++)
+            {
+                objectData.push_back(instance.modelMatrix[i]);
+            }
+            for(int i = 0; i < 3; i++)
+            {
+                objectData.push_back(glm::vec4(instance.normalMatrix[i], 0));
+            }
+            objectData.push_back(glm::vec4(instance.tint, 1));
+        }
+        // First vertex of a leaf mesh in the shared buffer, copied in the first time it's seen
+        int getMeshFirst(const std::shared_ptr<SierpinskiGeometry> &geometry)
+        {
+            std::map<const SierpinskiGeometry*, MeshRegion>::iterator found = meshRegions.find(geometry.get());
+            if(found != meshRegions.end())
+            {
+                if(!found->second.geometry.expired())
+                {
+                    return found->second.first;
+                }
+                // Left behind by a released geometry at the same address
+                deadVertices += found->second.count;
+                meshRegions.erase(found);
+            }
+            int count = geometry->getVertexCount();
+            if(vertexCount + count > vertexCapacity)
+            {
+                growVertexBuffer(std::max(2*vertexCapacity, vertexCount + count));
+            }
+            int stride = SierpinskiGeometry::getVertexStride();
+            glBindBuffer(GL_COPY_READ_BUFFER, geometry->getVertexBuffer());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexCount*stride, count*stride);
+
+            MeshRegion region;
+            region.geometry = geometry;
+            region.first = vertexCount;
+            region.count = count;
+            meshRegions[geometry.get()] = region;
+            vertexCount += count;
+            return region.first;
+        }
+        // Forgets meshes no pyramid holds anymore
+        // Once they're half the buffer, the live ones are packed together to get the space back
+        void releaseDeadRegions()
+        {
+            std::map<const SierpinskiGeometry*, MeshRegion>::iterator it = meshRegions.begin();
+            while(it != meshRegions.end())
+            {
+                if(it->second.geometry.expired())
+                {
+                    deadVertices += it->second.count;
+                    meshRegions.erase(it++);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+            if(deadVertices > 0 && 2*deadVertices >= vertexCount)
+            {
+                compactVertexBuffer();
+            }
+        }
+        // Copies the trunk cube and every live mesh to the front of new storage, on the GPU
+        // Only called before any object is added, so no instance holds an old position
+        void compactVertexBuffer()
+        {
+            int stride = SierpinskiGeometry::getVertexStride();
+            // int() hands std::max a copy, initialVertexCapacity has no definition to take a reference to
+            int newCapacity = std::max(int(initialVertexCapacity), 2*(vertexCount - deadVertices));
+            GLuint newBuffer = createVertexBuffer(newCapacity);
+            glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, trunkFirst*stride, 0, 36*stride);
+            trunkFirst = 0;
+            int next = 36;
+            std::map<const SierpinskiGeometry*, MeshRegion>::iterator it;
+            for(it = meshRegions.begin(); it != meshRegions.end(); it++)
+            {
+                MeshRegion &region = it->second;
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, region.first*stride, next*stride, region.count*stride);
+                region.first = next;
+                next += region.count;
+            }
+            vertexCount = next;
+            deadVertices = 0;
+            replaceVertexBuffer(newBuffer, newCapacity);
+        }
+        // Moves the shared buffer to bigger storage, keeping what's already in it
+        void growVertexBuffer(int newCapacity)
+        {
+            int stride = SierpinskiGeometry::getVertexStride();
+            GLuint newBuffer = createVertexBuffer(newCapacity);
+            if(vertexCount > 0)
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexCount*stride);
+            }
+            replaceVertexBuffer(newBuffer, newCapacity);
+        }
+        // Empty storage for newCapacity vertices, left bound to the copy write target
+        GLuint createVertexBuffer(int newCapacity)
+        {
+            GLuint newBuffer;
+            glGenBuffers(1, &newBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, newCapacity*SierpinskiGeometry::getVertexStride(), NULL, GL_STATIC_DRAW);
+            return newBuffer;
+        }
+        // Draws from newBuffer from now on, the old storage goes once the GPU is done with it
+        void replaceVertexBuffer(GLuint newBuffer, int newCapacity)
+        {
+            int stride = SierpinskiGeometry::getVertexStride();
+            glDeleteBuffers(1, &vertexBuffer);
+            vertexBuffer = newBuffer;
+            vertexCapacity = newCapacity;
+
+            // Same layout as SierpinskiGeometry: position, color, face normal
+            GLStateCache::bindVertexArray(vao);
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3*sizeof(GLfloat)));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(6*sizeof(GLfloat)));
+        }
+        // Same cube as IBOCube, every face with its own vertices so it has a normal
+        // White, each trunk's color is its tint
+        void setTrunkVertexData()
+        {
+            glm::vec3 cubeVerts[8] = {
+                glm::vec3(-0.5, -0.5, -0.5),
+                glm::vec3(0.5, -0.5, -0.5),
+                glm::vec3(0.5, 0.5, -0.5),
+                glm::vec3(-0.5, 0.5, -0.5),
+                glm::vec3(-0.5, -0.5, 0.5),
+                glm::vec3(-0.5, 0.5, 0.5),
+                glm::vec3(0.5, 0.5, 0.5),
+                glm::vec3(0.5, -0.5, 0.5)
+            };
+            GLfloat vertexData[36*9];
+            Cube cube = Cube(0, 1, 2, 3, 4, 5, 6, 7);
+            for(int i = 0; i < 12; i++)     //6 quads * 2 triangles per quad
+            {
+                const glm::ivec3 &face = cube.quads[i/2].faces[i%2];
+                int corners[3] = { face.x, face.y, face.z };
+                glm::vec3 normal = glm::normalize(glm::cross(cubeVerts[face.z] - cubeVerts[face.y], cubeVerts[face.x] - cubeVerts[face.y]));
+                for(int k = 0; k < 3; k++)
+                {
+                    GLfloat* vertex = vertexData + (i*3 + k)*9;
+                    vertex[0] = cubeVerts[corners[k]].x;
+                    vertex[1] = cubeVerts[corners[k]].y;
+                    vertex[2] = cubeVerts[corners[k]].z;
+                    vertex[3] = 1;
+                    vertex[4] = 1;
+                    vertex[5] = 1;
+                    vertex[6] = normal.x;
+                    vertex[7] = normal.y;
+                    vertex[8] = normal.z;
+                }
+            }
+            trunkFirst = vertexCount;
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, trunkFirst*9*sizeof(GLfloat), sizeof(vertexData), vertexData);
+            StartupProfiler::count("bytes uploaded", sizeof(vertexData));
+            vertexCount += 36;
+        }
+};
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+//General includes
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+//Opengl includes
+#include <GL/glew.h>
+
+// Per-frame CPU zones and GPU timer queries
+// Zones nest and always measure CPU time, endZone() hands it back so callers
+// can keep their own totals. While enabled, every zone is also kept as an
+// event in a ring buffer that can be written out as Chrome trace-event JSON
+// (chrome://tracing or ui.perfetto.dev), and zones opened with gpu set are
+// timed on the GPU with GL_TIME_ELAPSED queries. Those can't nest, so only
+// the innermost zones should ask for it. GPU results are read a few frames
+// later, once they're ready, so timing never stalls the pipeline.
+// Main (GL) thread only, zones opened on any other thread are ignored.
+class FrameProfiler {
+    public:
+        // Turns event recording and GPU queries on or off, zones keep returning CPU time either way
+        static void setEnabled(bool enabled)
+        {
+            State &s = state();
+            if(enabled && !s.enabled)
+            {
+                // Frames while disabled had no stage totals, don't average over them
+                s.frames = 0;
+            }
+            s.enabled = enabled;
+        }
+        static bool isEnabled()
+        {
+            return state().enabled;
+        }
+        // Collects finished GPU queries and opens the frame's zone
+        static void beginFrame()
+        {
+            State &s = state();
+            s.frame++;
+            collectQueries();
+            beginZone("frame");
+        }
+        static double endFrame()
+        {
+            double ms = endZone();
+            state().frames++;
+            return ms;
+        }
+        static void beginZone(const char* name, bool gpu = false)
+        {
+            State &s = state();
+            if(std::this_thread::get_id() != s.owner)
+            {
+                return;
+            }
+            OpenZone zone;
+            zone.name = name;
+            zone.start = std::chrono::steady_clock::now();
+            zone.query = 0;
+            // Stages are the zones right inside the frame, everything below them adds up into them
+            zone.stage = s.open.size() <= 1 ? name : s.open[1].name;
+            if(s.enabled && gpu && !s.gpuZoneOpen)
+            {
+                zone.query = getQuery();
+                glBeginQuery(GL_TIME_ELAPSED, zone.query);
+                s.gpuZoneOpen = true;
+            }
+            s.open.push_back(zone);
+        }
+        // Closes the innermost zone, returns its CPU time in milliseconds
+        static double endZone()
+        {
+            State &s = state();
+            if(std::this_thread::get_id() != s.owner || s.open.empty())
+            {
+                return 0;
+            }
+            OpenZone zone = s.open.back();
+            s.open.pop_back();
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(now - zone.start).count();
+            if(zone.query != 0)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                s.gpuZoneOpen = false;
+                PendingQuery pending;
+                pending.query = zone.query;
+                pending.name = zone.name;
+                pending.stage = zone.stage;
+                pending.startUs = toUs(zone.start);
+                pending.frame = s.frame;
+                s.pending.push_back(pending);
+            }
+            if(s.enabled)
+            {
+                addEvent(zone.name, toUs(zone.start), ms*1000.0, false, s.frame);
+                // Only count each stage once, not again for every zone inside it
+                if(s.open.size() == 1)
+                {
+                    getStage(zone.name).cpuMs += ms;
+                }
+            }
+            return ms;
+        }
+        // Average CPU/GPU ms per frame for each stage since the last call, then starts counting again
+        // GPU time shows up a few frames late, so it's spread over the same frames as the CPU time
+        static std::string getSummary()
+        {
+            State &s = state();
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(2);
+            int frames = s.frames > 0 ? s.frames : 1;
+            for(int i = 0; i < s.stageOrder.size(); i++)
+            {
+                StageTotals &stage = s.stages[s.stageOrder[i]];
+                out << (i == 0 ? "" : "  ") << s.stageOrder[i] << " " << stage.cpuMs/frames;
+                if(stage.gpuMs > 0)
+                {
+                    out << "/" << stage.gpuMs/frames;
+                }
+                stage.cpuMs = 0;
+                stage.gpuMs = 0;
+            }
+            out << " ms cpu/gpu";
+            s.frames = 0;
+            return out.str();
+        }
+        // Writes every event still in the ring buffer as Chrome trace-event JSON
+        static bool writeTrace(const std::string &path)
+        {
+            State &s = state();
+            std::ofstream out(path.c_str());
+            if(!out)
+            {
+                std::cerr << "couldn't open " << path << " for writing" << std::endl;
+                return false;
+            }
+            out << std::fixed << std::setprecision(3);
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+            out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU (GL thread)\"}}," << std::endl;
+            out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}";
+            int count = s.events.size() < ringSize ? s.events.size() : ringSize;
+            int first = s.events.size() < ringSize ? 0 : s.nextEvent;
+            for(int i = 0; i < count; i++)
+            {
+                const Event &event = s.events[(first + i) % ringSize];
+                out << "," << std::endl
+                    << "{\"name\": \"" << event.name << "\", \"cat\": \"" << (event.gpu ? "gpu" : "cpu")
+                    << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << (event.gpu ? 2 : 1)
+                    << ", \"ts\": " << event.startUs << ", \"dur\": " << event.durationUs
+                    << ", \"args\": {\"frame\": " << event.frame << "}}";
+            }
+            out << std::endl << "]}" << std::endl;
+            std::cout << "Wrote " << count << " trace events to " << path << std::endl;
+            return true;
+        }
+    private:
+        static const int ringSize = 1 << 16;    // events kept for the trace, oldest are overwritten
+        struct Event {
+            const char* name;
+            double startUs, durationUs;
+            bool gpu;
+            int frame;
+        };
+        struct OpenZone {
+            const char* name;
+            const char* stage;
+            std::chrono::steady_clock::time_point start;
+            GLuint query;       // 0 if not timed on the GPU
+        };
+        struct PendingQuery {
+            GLuint query;
+            const char* name;
+            const char* stage;
+            double startUs;     // GL_TIME_ELAPSED only has a duration, so GPU events start with their CPU zone
+            int frame;
+        };
+        struct StageTotals {
+            StageTotals()
+            {
+                cpuMs = 0;
+                gpuMs = 0;
+            }
+            double cpuMs, gpuMs;
+        };
+        struct State {
+            State()
+            {
+                enabled = false;
+                gpuZoneOpen = false;
+                frame = 0;
+                frames = 0;
+                nextEvent = 0;
+                owner = std::this_thread::get_id();
+                epoch = std::chrono::steady_clock::now();
+            }
+            bool enabled;
+            bool gpuZoneOpen;
+            int frame;              // current frame number
+            int frames;             // frames since the last summary
+            std::thread::id owner;
+            std::chrono::steady_clock::time_point epoch;
+            std::vector<OpenZone> open;             // innermost last, open[0] is the frame
+            std::deque<PendingQuery> pending;       // oldest first, results arrive in order
+            std::vector<GLuint> freeQueries;
+            std::vector<Event> events;
+            int nextEvent;
+            std::map<std::string, StageTotals> stages;
+            std::vector<std::string> stageOrder;    // stages in the order they first ran
+        };
+        // Function-local so it exists before any global object uses it
+        // Created by the first call, which has to come from the GL thread
+        static State &state()
+        {
+            static State current;
+            return current;
+        }
+        static double toUs(const std::chrono::steady_clock::time_point &time)
+        {
+            return std::chrono::duration<double, std::micro>(time - state().epoch).count();
+        }
+        static void addEvent(const char* name, double startUs, double durationUs, bool gpu, int frame)
+        {
+            State &s = state();
+            Event event;
+            event.name = name;
+            event.startUs = startUs;
+            event.durationUs = durationUs;
+            event.gpu = gpu;
+            event.frame = frame;
+            if(s.events.size() < ringSize)
+            {
+                s.events.push_back(event);
+            }
+            else
+            {
+                s.events[s.nextEvent] = event;
+            }
+            s.nextEvent = (s.nextEvent + 1) % ringSize;
+        }
+        static StageTotals &getStage(const char* name)
+        {
+            State &s = state();
+            if(s.stages.find(name) == s.stages.end())
+            {
+                s.stageOrder.push_back(name);
+            }
+            return s.stages[name];
+        }
+        static GLuint getQuery()
+        {
+            State &s = state();
+            if(s.freeQueries.empty())
+            {
+                GLuint query;
+                glGenQueries(1, &query);
+                return query;
+            }
+            GLuint query = s.freeQueries.back();
+            s.freeQueries.pop_back();
+            return query;
+        }
+        // Reads back every GPU query that has finished, without waiting on any
+        static void collectQueries()
+        {
+            State &s = state();
+            while(!s.pending.empty())
+            {
+                PendingQuery &pending = s.pending.front();
+                GLint available = 0;
+                glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if(!available)
+                {
+                    return;
+                }
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &ns);
+                addEvent(pending.name, pending.startUs, ns/1000.0, true, pending.frame);
+                getStage(pending.stage).gpuMs += ns/1000000.0;
+                s.freeQueries.push_back(pending.query);
+                s.pending.pop_front();
+            }
+        }
+};
+
+// Times a zone from construction to the end of the enclosing scope
+class ScopedZone {
+    public:
+        ScopedZone(const char* name, bool gpu = false)
+        {
+            FrameProfiler::beginZone(name, gpu);
+        }
+        ~ScopedZone()
+        {
+            FrameProfiler::endZone();
+        }
+    private:
+        ScopedZone(const ScopedZone&);
+        ScopedZone &operator=(const ScopedZone&);
+};
+
+#endif
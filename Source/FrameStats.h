@@ -0,0 +1,92 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+//General includes
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+// Frame times collected over a benchmark run
+// Each frame is split into CPU time (building and submitting the frame) and
+// GPU wait (blocked until the GPU has finished it), both in milliseconds.
+class FrameStats {
+    public:
+        void init(int expectedFrames)
+        {
+            cpuMs.clear();
+            gpuWaitMs.clear();
+            frameMs.clear();
+            cpuMs.reserve(expectedFrames);
+            gpuWaitMs.reserve(expectedFrames);
+            frameMs.reserve(expectedFrames);
+        }
+        void addFrame(double cpu, double gpuWait)
+        {
+            cpuMs.push_back(cpu);
+            gpuWaitMs.push_back(gpuWait);
+            frameMs.push_back(cpu + gpuWait);
+        }
+        int size()
+        {
+            return frameMs.size();
+        }
+        // Writes "frameMs", "cpuMs" and "gpuWaitMs" summaries as JSON members
+        // Every line starts with indent, the caller writes the surrounding braces
+        void writeJson(std::ostream &out, const char* indent)
+        {
+            writeSummary(out, indent, "frameMs", frameMs);
+            out << "," << std::endl;
+            writeSummary(out, indent, "cpuMs", cpuMs);
+            out << "," << std::endl;
+            writeSummary(out, indent, "gpuWaitMs", gpuWaitMs);
+            out << "," << std::endl;
+            // Share of the total frame time spent on the CPU side
+            double cpuTotal = 0, frameTotal = 0;
+            for(int i = 0; i < frameMs.size(); i++)
+            {
+                cpuTotal += cpuMs[i];
+                frameTotal += frameMs[i];
+            }
+            out << indent << "\"cpuShare\": " << (frameTotal > 0 ? cpuTotal/frameTotal : 0.0);
+        }
+    private:
+        std::vector<double> cpuMs, gpuWaitMs, frameMs;
+
+        // mean, p50, p99 and max of one series
+        void writeSummary(std::ostream &out, const char* indent, const char* name, std::vector<double> samples)
+        {
+            double mean = 0;
+            for(int i = 0; i < samples.size(); i++)
+            {
+                mean += samples[i];
+            }
+            if(!samples.empty())
+            {
+                mean /= samples.size();
+            }
+            std::sort(samples.begin(), samples.end());
+            out << indent << "\"" << name << "\": {"
+                << "\"mean\": " << mean
+                << ", \"p50\": " << percentile(samples, 0.50)
+                << ", \"p99\": " << percentile(samples, 0.99)
+                << ", \"max\": " << (samples.empty() ? 0.0 : samples.back())
+                << "}";
+        }
+        // Nearest-rank percentile of already sorted samples
+        double percentile(const std::vector<double> &sorted, double fraction)
+        {
+            if(sorted.empty())
+            {
+                return 0;
+            }
+            int rank = (int)std::ceil(fraction*sorted.size());
+            if(rank < 1)
+            {   rank = 1;   }
+            if(rank > sorted.size())
+            {   rank = sorted.size();   }
+            return sorted[rank-1];
+        }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+//General includes
+#include <iostream>
+
+//Opengl includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// View, projection and time for the whole frame, in one uniform buffer
+// Uploaded once per frame instead of with every draw. Shaders read it by declaring
+//   layout(std140) uniform FrameUniforms {
+//       mat4 viewMatrix;
+//       mat4 projectionMatrix;
+//       mat4 viewProjectionMatrix;
+//       float time;
+//   };
+// and every program that does is pointed at the same binding point with bindProgram().
+class FrameUniforms {
+    public:
+        FrameUniforms()
+        {
+            ubo = 0;
+        }
+        void init()
+        {
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, ubo);
+        }
+        // Uploads this frame's values, everything drawn after this sees them
+        void update(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, float time)
+        {
+            Block block;
+            block.viewMatrix = viewMatrix;
+            block.projectionMatrix = projectionMatrix;
+            block.viewProjectionMatrix = projectionMatrix * viewMatrix;
+            block.time = glm::vec4(time, 0, 0, 0);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            // Whole new storage, so the last frame's draws never have to finish first
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+        }
+        // Points a program's FrameUniforms block at the shared buffer
+        static void bindProgram(GLuint program)
+        {
+            GLuint index = glGetUniformBlockIndex(program, "FrameUniforms");
+            if(index == GL_INVALID_INDEX)
+            {
+                std::cerr << "couldn't find FrameUniforms in shader\n";
+                return;
+            }
+            glUniformBlockBinding(program, index, bindingPoint);
+        }
+    private:
+        static const GLuint bindingPoint = 0;
+        // std140 layout: each mat4 is 64 bytes, the float is padded out to a vec4
+        struct Block {
+            glm::mat4 viewMatrix;
+            glm::mat4 projectionMatrix;
+            glm::mat4 viewProjectionMatrix;
+            glm::vec4 time;
+        };
+        GLuint ubo;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+//General includes
+#include <map>
+
+//Opengl includes
+#include <GL/glew.h>
+
+// Remembers the OpenGL state set through it and drops calls that wouldn't change anything
+// Tracks the bound program, VAO, array and index buffers, polygon mode and
+// offset, and glEnable/glDisable flags. Vertex attributes aren't tracked:
+// every mesh records its own in its VAO.
+// Anything set behind its back must be followed by invalidate().
+// GL thread only, like every other GL call.
+class GLStateCache {
+    public:
+        static void useProgram(GLuint program)
+        {
+            State &s = state();
+            if(s.program == program)
+            {
+                s.skipped++;
+                return;
+            }
+            glUseProgram(program);
+            s.program = program;
+            s.issued++;
+        }
+        static void bindVertexArray(GLuint vao)
+        {
+            State &s = state();
+            if(s.vao == vao)
+            {
+                s.skipped++;
+                return;
+            }
+            glBindVertexArray(vao);
+            s.vao = vao;
+            // The index buffer binding belongs to the VAO
+            s.elementBuffer = unknown;
+            s.issued++;
+        }
+        // Array and index buffer bindings are tracked, any other target is passed straight through
+        static void bindBuffer(GLenum target, GLuint buffer)
+        {
+            State &s = state();
+            GLuint* bound = NULL;
+            if(target == GL_ARRAY_BUFFER)
+            {   bound = &s.arrayBuffer; }
+            else if(target == GL_ELEMENT_ARRAY_BUFFER)
+            {   bound = &s.elementBuffer;   }
+
+            if(bound != NULL && *bound == buffer)
+            {
+                s.skipped++;
+                return;
+            }
+            glBindBuffer(target, buffer);
+            if(bound != NULL)
+            {
+                *bound = buffer;
+            }
+            s.issued++;
+        }
+        static void setEnabled(GLenum capability, bool enabled)
+        {
+            State &s = state();
+            std::map<GLenum, bool>::iterator it = s.capabilities.find(capability);
+            if(it != s.capabilities.end() && it->second == enabled)
+            {
+                s.skipped++;
+                return;
+            }
+            if(enabled)
+            {   glEnable(capability);   }
+            else
+            {   glDisable(capability);  }
+            s.capabilities[capability] = enabled;
+            s.issued++;
+        }
+        // Front and back faces always share a mode in this program
+        static void polygonMode(GLenum mode)
+        {
+            State &s = state();
+            if(s.polygonMode == mode)
+            {
+                s.skipped++;
+                return;
+            }
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+            s.polygonMode = mode;
+            s.issued++;
+        }
+        static void polygonOffset(GLfloat factor, GLfloat units)
+        {
+            State &s = state();
+            if(s.offsetKnown && s.offsetFactor == factor && s.offsetUnits == units)
+            {
+                s.skipped++;
+                return;
+            }
+            glPolygonOffset(factor, units);
+            s.offsetFactor = factor;
+            s.offsetUnits = units;
+            s.offsetKnown = true;
+            s.issued++;
+        }
+        // Forgets everything, the next call of each kind always reaches OpenGL
+        static void invalidate()
+        {
+            State &s = state();
+            int issued = s.issued;
+            int skipped = s.skipped;
+            int draws = s.draws;
+            s = State();
+            s.issued = issued;
+            s.skipped = skipped;
+            s.draws = draws;
+        }
+        // Calls that reached OpenGL and calls that were dropped since the last reset
+        static void resetCounts()
+        {
+            state().issued = 0;
+            state().skipped = 0;
+            state().draws = 0;
+        }
+        // Draw calls aren't state, but they're counted alongside it by whoever makes them
+        static void countDraws(int count)
+        {
+            state().draws += count;
+        }
+        static int getDraws()
+        {
+            return state().draws;
+        }
+        static int getIssued()
+        {
+            return state().issued;
+        }
+        static int getSkipped()
+        {
+            return state().skipped;
+        }
+    private:
+        static const GLuint unknown = 0xFFFFFFFF;
+        struct State {
+            State()
+            {
+                program = unknown;
+                vao = unknown;
+                arrayBuffer = unknown;
+                elementBuffer = unknown;
+                polygonMode = 0;
+                offsetKnown = false;
+                offsetFactor = 0;
+                offsetUnits = 0;
+                issued = 0;
+                skipped = 0;
+                draws = 0;
+            }
+            GLuint program, vao, arrayBuffer, elementBuffer;
+            std::map<GLenum, bool> capabilities;
+            GLenum polygonMode;                 // 0 until first set
+            bool offsetKnown;
+            GLfloat offsetFactor, offsetUnits;
+            int issued, skipped, draws;
+        };
+        // Function-local so the state exists before any global object uses it
+        static State &state()
+        {
+            static State current;
+            return current;
+        }
+};
+
+#endif
@@ -20,9 +20,14 @@
 //Project-specific includes
 #include "LoadShaders.h"
 #include "Primitives.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "StartupProfiler.h"
+#include "BoundingVolumes.h"
+#include "FrameUniforms.h"
 
 // Cube class
-class IBOCube {
+class IBOCube : public Renderable {
     public:
         IBOCube(){}
         void init(GLFWwindow* window, glm::vec3 position, glm::mat4 scale, glm::mat4 rotation, glm::vec3 color)
@@ -34,16 +39,29 @@ class IBOCube {
             currentPosition = position;
             translationMatrix = glm::translate(position);
             rotationMatrix = glm::mat4(1);
+            modelDirty = true;
+            objectColor = color;
             setCubeColors(color);
 
             // Load and compile shaders
-            cubeShader = LoadShaders("o2wShader.vrt.glsl", "passthrough.geo.glsl", "colorShader.frg.glsl");
+            // There's no geometry stage, unless the old path was asked for
+            if(useGeometryShader())
+            {
+                cubeShader = LoadShaders("cube.vrt.glsl", "passthrough.geo.glsl", "colorShader.frg.glsl");
+            }
+            else
+            {
+                cubeShader = LoadShaders("cube.vrt.glsl", "colorShader.frg.glsl");
+            }
             glUseProgram(cubeShader);
 
-            // initialize MVP Matrix array reference in shader
-            MVPMatrices_ref = glGetUniformLocation(cubeShader, "matrices");
-            if(MVPMatrices_ref < 0)
-            {   std::cerr << "couldn't find MVP matrices in shader\n";  }
+            // View and projection come from the frame's uniform buffer
+            FrameUniforms::bindProgram(cubeShader);
+
+            // initialize model matrix reference in shader
+            modelMatrixRef = glGetUniformLocation(cubeShader, "modelMatrix");
+            if(modelMatrixRef < 0)
+            {   std::cerr << "couldn't find modelMatrix in shader\n";  }
 
             // initialize wireframe color reference in shaders
             wireframeColorRef = glGetUniformLocation(cubeShader, "wireframeColor");
@@ -59,83 +77,74 @@ class IBOCube {
             glUniform3fv(wireframeColorRef, 1, glm::value_ptr(wireframeColor));
 
             //Generate VAO for this cube
+            // It records the vertex layout, so drawing only has to bind it
             glGenVertexArrays(1, &vao);
-            glBindVertexArray(vao);
-
-            // Generate position, color, and IBO buffers for this cube
-            glGenBuffers(1, &positionBuffer);
-            glGenBuffers(1, &colorBuffer);
-            glGenBuffers(1, &ibo);
+            GLStateCache::bindVertexArray(vao);
 
+            // Generate interleaved position/color buffer for this cube
+            glGenBuffers(1, &vertexBuffer);
 
             setVertexBufferData();
-            setColorBufferData();
-            setIndexBufferData();
+        }
+        // Rebuilds the model matrix if the cube moved, without touching OpenGL
+        // Safe to call for different objects from different threads
+        void update()
+        {
+            getModelMatrix();
         }
         // draw function
         // Draws every triangle in the vertexbuffer with a color corresponding to the colorbuffer
-        void draw(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+        // Uses the model matrix from the last update() and the frame's view and projection
+        void draw()
+        {
+            // draw triangle faces and/or wireframe, in one pass if single-pass wireframe is on
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                drawPass(passes[i]);
+            }
+        }
+        // Queues this frame's passes instead of drawing them right away
+        void submit(RenderQueue &queue)
+        {
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                queue.add(cubeShader, passes[i], this);
+            }
+        }
+        // Draws a single pass, only state that differs from the last draw is sent
+        void drawPass(RenderPass pass)
         {
             // Use shader for the cube
-            // Doesn't need to be done every frame unless there are non-cube
-            // objects in scene
-            glUseProgram(cubeShader);
+            GLStateCache::useProgram(cubeShader);
 
-            // cull backfaces
-            glEnable(GL_CULL_FACE);  
+            // cull backfaces, but draw the whole wireframe, back edges included in the single pass too
+            GLStateCache::setEnabled(GL_CULL_FACE, pass == FacesPass);
+            setRenderPassState(pass);
 
-            // Use IBO
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+            // This cube's VAO has the vertex layout
+            GLStateCache::bindVertexArray(vao);
 
-            // Use position buffer
-            glEnableVertexAttribArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
-            glVertexAttribPointer(
-                0,
-                3,
-                GL_FLOAT,
-                GL_FALSE,
-                0,
-                (void*)0
-            );
-
-            // Use color buffer
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-            glVertexAttribPointer(
-                1,
-                3,
-                GL_FLOAT,
-                GL_FALSE,
-                0,
-                (void*)0
-            );
-
-            // Render relative to the camera
-            updateMVPArray(viewMatrix, projectionMatrix);
-            glUniformMatrix4fv(MVPMatrices_ref, 5, GL_FALSE, glm::value_ptr(MVPMatrices[0])); // Passing 5 matrices
+            // Place the cube, the camera's matrices are already in the frame's uniform buffer
+            glUniformMatrix4fv(modelMatrixRef, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 
             // Set wireframe color
             glUniform3fv(wireframeColorRef, 1, glm::value_ptr(wireframeColor));
 
-            // draw triangle faces
-            if(renderFaces)
-            {
-                renderAsFaces();
-            }
+            // Send colorType to shader, 1 for faces, 0 for wireframe and 2 for both
+            glUniform1i(colorTypeRef, getColorType(pass));
 
-            // draw triangle wireframe
-            if(renderWireframe)
-            {
-                renderAsWireframe();
-            }
-
-            // Disable cull face in case next object doesn't want to cull faces
-            glDisable(GL_CULL_FACE);  
-
-            // disable position/color buffers
-            glDisableVertexAttribArray(0);
-            glDisableVertexAttribArray(1);
+            // Every face has its own three vertices
+            glDrawArrays(GL_TRIANGLES, 0, 36);     //6 quads * 2 triangles per quad * 3 vertices per triangle
+            GLStateCache::countDraws(1);
+        }
+        const char* getProfileName(RenderPass pass)
+        {
+            const char* names[renderPassCount] = { "cubes", "cubes wireframe", "cubes + wireframe" };
+            return names[pass];
         }
         //  Toggle wireframe/faces on and off
         void toggleWireframe()
@@ -157,36 +166,71 @@ class IBOCube {
             renderFaces = true;
             renderWireframe = false;
         }
+        // Anything that moves the cube marks the model matrix to be rebuilt
         void setRotation(float angle, glm::vec3 axis)
         {
             rotationMatrix = glm::rotate(angle, axis);
+            modelDirty = true;
         }
         //TODO: rotate function
         void setPosition(const glm::vec3 &position)
         {
             currentPosition = position;
             translationMatrix = glm::translate(glm::mat4(1), position);
+            modelDirty = true;
         }
         // translate function moves object relative to previous location
         void translate(const glm::vec3 &translation)
         {
             translationMatrix = glm::translate(translationMatrix, translation);
+            modelDirty = true;
+        }
+        // Cubes initialized after this go through passthrough.geo.glsl, only kept to benchmark against
+        static void setGeometryShaderPath(bool enabled)
+        {
+            useGeometryShader() = enabled;
         }
         // returns xyz position in worldspace
         glm::vec3 getPosition()
         {
             return currentPosition;
         }
+        // World-space box around the cube as it's currently placed
+        AABB getBounds()
+        {
+            AABB local(glm::vec3(-0.5), glm::vec3(0.5));
+            return local.transformed(getModelMatrix());
+        }
+        glm::vec3 getColor()
+        {
+            return objectColor;
+        }
+        // Passes this cube draws this frame, for drawing it as part of a batch
+        int getPasses(RenderPass passes[2])
+        {
+            return getRenderPasses(renderFaces, renderWireframe, passes);
+        }
+        // translation * rotation * scaling, rebuilt only if the cube moved since the last call
+        const glm::mat4 &getModelMatrix()
+        {
+            if(modelDirty)
+            {
+                modelMatrix = translationMatrix * rotationMatrix * scalingMatrix;
+                modelDirty = false;
+            }
+            return modelMatrix;
+        }
     private:
         glm::mat4 translationMatrix, scalingMatrix, rotationMatrix;
-        // MVPMatrices will contain the same data as the 3 matrices above, as well as passed view & projection matrices
-        // The above matrices are just friendly names instead of requiring me to remember index 0 == translationMatrix etc
-        glm::mat4 MVPMatrices[5];
-        GLuint cubeShader, vao, ibo, positionBuffer, colorBuffer;
-        GLint MVPMatrices_ref, wireframeColorRef, colorTypeRef;     //glUniform location references for shader
+        // The 3 matrices above multiplied together, only when one of them changes
+        glm::mat4 modelMatrix;
+        bool modelDirty;
+        GLuint cubeShader, vao, vertexBuffer;
+        GLint modelMatrixRef, wireframeColorRef, colorTypeRef;     //glUniform location references for shader
         GLFWwindow* window;
         glm::vec3 wireframeColor = glm::vec3(1.0, 1.0, 1.0);    //Color for the wireframe
         glm::vec3 currentPosition;      //xyz position instead of pure translation matrix
+        glm::vec3 objectColor;          //Color for every vertex
         GLfloat cubeColors[24];         //color data for each vertex
         GLfloat cubeVerts[24] = {       //Basic cube coordinates
             -0.5, -0.5, -0.5,           //TODO: center on origin for easy positioning in worldspace
@@ -198,56 +242,12 @@ class IBOCube {
             0.5, 0.5, 0.5,
             0.5, -0.5, 0.5
         };
-        unsigned int cubeIndices[36];   // Indices to be passed to IBO
+        unsigned int cubeIndices[36];   // Corners of each triangle, in order
         bool renderFaces, renderWireframe;
-        // update existing MVP array from matrices with friendly names
-        void updateMVPArray(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+        static bool &useGeometryShader()
         {
-            // This order is really important
-            MVPMatrices[0] = scalingMatrix;
-            MVPMatrices[1] = rotationMatrix;
-            MVPMatrices[2] = translationMatrix;
-            MVPMatrices[3] = viewMatrix;
-            MVPMatrices[4] = projectionMatrix;
-        }
-        void renderAsFaces()
-        {  
-            // Set polygon mode to fill
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-            // Send colorType for faces to shader
-            glUniform1i(colorTypeRef, 1);
-
-            glDrawElements(
-                GL_TRIANGLES,
-                36,     //6 quads * 2 triangles per quad * 3 indices per triangle
-                GL_UNSIGNED_INT,
-                (void*)0
-            );
-
-            glDisable(GL_CULL_FACE);
-        }
-        void renderAsWireframe()
-        {
-            // polygon offset line displaces the vertices towards the camera a little bit
-            glEnable(GL_POLYGON_OFFSET_LINE);
-
-            glPolygonOffset(0.1, -1);
-            // Set polygon mode to line
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                      
-            // Send colorType for wireframe to shader
-            glUniform1i(colorTypeRef, 0);
-
-            // Actually draw wireframe
-            glDrawElements(
-                GL_TRIANGLES,
-                36,     //6 quads * 2 triangles per quad * 3 indices per triangle
-                GL_UNSIGNED_INT,
-                (void*)0
-            );
-
-            glDisable(GL_POLYGON_OFFSET_LINE);
+            static bool enabled = false;
+            return enabled;
         }
         // Generates color array from a given color
         void setCubeColors(glm::vec3 color)
@@ -259,30 +259,44 @@ class IBOCube {
                 cubeColors[i*3+2] = color.z;
             }
         }
-        // Sets VBO data from vertex position array
+        // Sets VBO data from the vertex position and color arrays, interleaved
+        // and records the layout in the VAO: position at 0, color at 1
+        // Corners are repeated for every triangle they're in, so each face's three
+        // vertices are in a row and shaders can tell them apart by gl_VertexID
         void setVertexBufferData()
         {
-            glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                24*sizeof(GLfloat),
-                cubeVerts,
-                GL_STATIC_DRAW
-            );
-        }
-        // Sets color buffer data from color array
-        void setColorBufferData()
-        {
-            glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+            setCubeIndices();
+            GLfloat vertexData[36*6];
+            for(int i = 0; i < 36; i++)
+            {
+                int corner = cubeIndices[i];
+                vertexData[(i*6)+0] = cubeVerts[(corner*3)+0];
+                vertexData[(i*6)+1] = cubeVerts[(corner*3)+1];
+                vertexData[(i*6)+2] = cubeVerts[(corner*3)+2];
+                vertexData[(i*6)+3] = cubeColors[(corner*3)+0];
+                vertexData[(i*6)+4] = cubeColors[(corner*3)+1];
+                vertexData[(i*6)+5] = cubeColors[(corner*3)+2];
+            }
+
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
             glBufferData(
                 GL_ARRAY_BUFFER,
-                24*sizeof(GLfloat),
-                cubeColors,
+                36*6*sizeof(GLfloat),
+                vertexData,
                 GL_STATIC_DRAW
             );
+            StartupProfiler::count("bytes uploaded", 36*6*sizeof(GLfloat));
+
+            // Position
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)0);
+
+            // Color
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)(3*sizeof(GLfloat)));
         }
-        // Generate IBO
-        void setIndexBufferData()
+        // Which corner each triangle's vertices come from
+        void setCubeIndices()
         {
             // I'll be honest here, Cube from Primitives.h isn't necessary here
             // But this current IBOCube class started off as a MengerSponge, where it was necessary
@@ -297,13 +311,6 @@ class IBOCube {
                 cubeIndices[i*6 + 4] = cube.quads[i].faces[1].y;
                 cubeIndices[i*6 + 5] = cube.quads[i].faces[1].z;
             }
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-            glBufferData(
-                GL_ELEMENT_ARRAY_BUFFER, 
-                36*sizeof(unsigned int),      //6 quads, 2 triangles per quad, 3 vertices (indices) per triangle
-                cubeIndices,
-                GL_STATIC_DRAW
-            );
         }
 };
 
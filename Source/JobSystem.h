@@ -0,0 +1,246 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+//General includes
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Small work-stealing thread pool
+// Every thread (the calling thread included) has its own job queue. Threads
+// take work from the back of their own queue and, once that runs dry, steal
+// from the front of everybody else's, so uneven chunks still balance out.
+// Jobs must not touch OpenGL: only the thread that owns the context may.
+class JobSystem {
+    public:
+        JobSystem()
+        {
+            running = false;
+            queuedJobs = 0;
+            nextWorker = 0;
+            queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+        }
+        ~JobSystem()
+        {
+            shutdown();
+        }
+        // Starts threadCount-1 workers, the calling thread is the last one
+        // 0 or less picks one thread per core
+        void init(int threadCount)
+        {
+            shutdown();
+            if(threadCount <= 0)
+            {
+                threadCount = std::thread::hardware_concurrency();
+                if(threadCount <= 0)
+                {   threadCount = 1;    }
+            }
+
+            queues.clear();
+            for(int i = 0; i < threadCount; i++)
+            {
+                queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+            }
+
+            running = true;
+            for(int i = 1; i < threadCount; i++)
+            {
+                workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+            }
+        }
+        // Stops and joins every worker
+        void shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+                running = false;
+            }
+            wake.notify_all();
+            for(int i = 0; i < workers.size(); i++)
+            {
+                workers[i].join();
+            }
+            workers.clear();
+        }
+        int getThreadCount()
+        {
+            return queues.size();
+        }
+        // Calls task(begin, end) over [0, count) split into chunks of at least minChunk
+        // Returns once every chunk has finished; the calling thread helps out
+        void parallelFor(int count, int minChunk, const std::function<void(int, int)> &task)
+        {
+            if(count <= 0)
+            {
+                return;
+            }
+            int threads = getThreadCount();
+            // A few chunks per thread leaves something to steal
+            int chunkSize = (count + threads*4 - 1) / (threads*4);
+            if(chunkSize < minChunk)
+            {   chunkSize = minChunk;   }
+            int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+            // Small jobs, or no workers, just run right here
+            if(threads == 1 || chunkCount == 1)
+            {
+                task(0, count);
+                return;
+            }
+
+            std::atomic<int> remaining(chunkCount);
+            for(int c = 0; c < chunkCount; c++)
+            {
+                int begin = c*chunkSize;
+                int end = std::min(begin + chunkSize, count);
+                Job job;
+                job.task = [&task, begin, end]() { task(begin, end); };
+                job.remaining = &remaining;
+
+                // Deal chunks out round-robin, stealing evens out the rest
+                JobQueue &queue = *queues[c % threads];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                queue.jobs.push_back(job);
+                queuedJobs++;
+            }
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+            }
+            wake.notify_all();
+
+            // Help until every chunk is done
+            // Only our own chunks, so a long background job can't stall the caller
+            while(remaining > 0)
+            {
+                if(!runOne(0, &remaining))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        // Runs task on a worker thread at some point, without waiting for it
+        // Without workers the task just runs right away
+        void submit(const std::function<void()> &task)
+        {
+            int threads = getThreadCount();
+            if(threads == 1)
+            {
+                task();
+                return;
+            }
+
+            Job job;
+            job.task = task;
+            job.remaining = NULL;
+
+            // Spread background work over the worker queues, never the caller's
+            JobQueue &queue = *queues[1 + (nextWorker++ % (threads-1))];
+            {
+                std::lock_guard<std::mutex> guard(queue.lock);
+                queue.jobs.push_back(job);
+                queuedJobs++;
+            }
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+            }
+            wake.notify_all();
+        }
+    private:
+        struct Job {
+            std::function<void()> task;
+            std::atomic<int>* remaining;    // chunks left in the parallelFor this job belongs to, NULL for submit()
+        };
+        struct JobQueue {
+            std::mutex lock;
+            std::deque<Job> jobs;
+        };
+        std::vector<std::unique_ptr<JobQueue> > queues;     // queues[0] belongs to the calling thread
+        std::vector<std::thread> workers;
+        std::mutex sleepLock;
+        std::condition_variable wake;
+        std::atomic<int> queuedJobs;
+        unsigned int nextWorker;        // round-robin target for submit()
+        bool running;
+
+        // Runs one job from our own queue, or stolen from another one
+        // If group is set, only jobs from that parallelFor are taken
+        // Returns false if there was nothing to run
+        bool runOne(int self, std::atomic<int>* group = NULL)
+        {
+            Job job;
+            bool found = false;
+            int threads = queues.size();
+            for(int i = 0; i < threads && !found; i++)
+            {
+                JobQueue &queue = *queues[(self + i) % threads];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if(queue.jobs.empty())
+                {
+                    continue;
+                }
+                if(group != NULL)
+                {
+                    for(std::deque<Job>::iterator it = queue.jobs.begin(); it != queue.jobs.end(); it++)
+                    {
+                        if(it->remaining == group)
+                        {
+                            job = *it;
+                            queue.jobs.erase(it);
+                            found = true;
+                            break;
+                        }
+                    }
+                }
+                // Newest work from our own queue, oldest work from anybody else's
+                else if(i == 0)
+                {
+                    job = queue.jobs.back();
+                    queue.jobs.pop_back();
+                    found = true;
+                }
+                else
+                {
+                    job = queue.jobs.front();
+                    queue.jobs.pop_front();
+                    found = true;
+                }
+                if(found)
+                {
+                    queuedJobs--;
+                }
+            }
+            if(found)
+            {
+                job.task();
+                if(job.remaining != NULL)
+                {
+                    (*job.remaining)--;
+                }
+            }
+            return found;
+        }
+        void workerLoop(int self)
+        {
+            while(true)
+            {
+                if(runOne(self))
+                {
+                    continue;
+                }
+                std::unique_lock<std::mutex> guard(sleepLock);
+                wake.wait(guard, [this]() { return queuedJobs > 0 || !running; });
+                if(!running)
+                {
+                    return;
+                }
+            }
+        }
+};
+
+#endif
@@ -8,130 +8,100 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <map>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
 
+#include "StartupProfiler.h"
 
-// Function to load shaders
-// It looks pretty long and annoying, but it's mostly boilerplate code to
-//  read from a file. Anything actually interesting with shaders happens a little
-//  less than halfway through
-// TODO: this is actually all boilerplate. Putting it in a separate file to use later
-//  would be a good idea
-GLuint LoadShaders(const char * vertex_file_path, const char * geometry_file_path, const char * fragment_file_path)
-{
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint GeometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-    // This part is just reading from a file, nothing to do with computer graphics
-    // This is always so fiddly, I really don't mind copy/pasting from the tutorial
-    // even if I would do it differently.
-    // http://www.opengl-tutorial.org/beginners-tutorials/tutorial-2-the-first-triangle/
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
-		return 0;
-	}
 
-	// Read the Geometry Shader code from the file
-	std::string GeometryShaderCode;
-	std::ifstream GeometryShaderStream(geometry_file_path, std::ios::in);
-	if(GeometryShaderStream.is_open()){
+// Reads a whole shader file into code
+// This part is just reading from a file, nothing to do with computer graphics
+// This is always so fiddly, I really don't mind copy/pasting from the tutorial
+// even if I would do it differently.
+// http://www.opengl-tutorial.org/beginners-tutorials/tutorial-2-the-first-triangle/
+bool ReadShaderFile(const char * file_path, std::string &code)
+{
+	ScopedPhase phase("file I/O");
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if(ShaderStream.is_open()){
 		std::stringstream sstr;
-		sstr << GeometryShaderStream.rdbuf();
-		GeometryShaderCode = sstr.str();
-		GeometryShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", geometry_file_path);
-		getchar();
-		return 0;
+		sstr << ShaderStream.rdbuf();
+		code = sstr.str();
+		ShaderStream.close();
+		StartupProfiler::count("shader files read", 1);
+		StartupProfiler::count("shader bytes read", code.size());
+		return true;
 	}
+	printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", file_path);
+	getchar();
+	return false;
+}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", fragment_file_path);
-		getchar();
-		return 0;
-	}
+// Compiles a single shader stage and prints whatever the compiler had to say about it
+GLuint CompileShader(GLenum type, const char * file_path, const std::string &code)
+{
+	GLuint ShaderID = glCreateShader(type);
 
     // Init result variables to check return values
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
-	// Compile Vertex Shader
     // Read shader as c_string
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-    // Read shader source into VertexShaderID
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	char const * SourcePointer = code.c_str();
+    // Read shader source into ShaderID
+	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
     // Compile shader
-	glCompileShader(VertexShaderID);
+	glCompileShader(ShaderID);
 
-	// Check Vertex Shader
+	// Check Shader
     // These functions get the requested shader information
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("Compiling shader : %s\n", vertex_file_path);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("Compiling shader : %s\n", file_path);
+		printf("%s\n", &ShaderErrorMessage[0]);
 	}
+	return ShaderID;
+}
 
-	// Compile Geometry Shader
-    // Read shader as c_string
-	char const * GeometrySourcePointer = GeometryShaderCode.c_str();
-    // Read shader source into GeometryShaderID
-	glShaderSource(GeometryShaderID, 1, &GeometrySourcePointer , NULL);
-    // Compile shader
-	glCompileShader(GeometryShaderID);
+// Compiles and links a program from shader sources that were already read
+// A NULL geometry path leaves the geometry stage out
+// If retrievable is set, the driver is asked to keep the linked binary around
+//  so it can be saved with glGetProgramBinary
+GLuint CompileShaderProgram(const char * vertex_file_path, const std::string &VertexShaderCode,
+	const char * geometry_file_path, const std::string &GeometryShaderCode,
+	const char * fragment_file_path, const std::string &FragmentShaderCode,
+	bool retrievable)
+{
+	ScopedPhase phase("compile + link");
+	StartupProfiler::count("programs compiled", 1);
 
-	// Check Vertex Shader
-    // These functions get the requested shader information
-	glGetShaderiv(GeometryShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(GeometryShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> GeometryShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(GeometryShaderID, InfoLogLength, NULL, &GeometryShaderErrorMessage[0]);
-		printf("Compiling shader : %s\n", geometry_file_path);
-		printf("%s\n", &GeometryShaderErrorMessage[0]);
+	// Create and compile the shaders
+	GLuint VertexShaderID = CompileShader(GL_VERTEX_SHADER, vertex_file_path, VertexShaderCode);
+	GLuint GeometryShaderID = 0;
+	if(geometry_file_path != NULL){
+		GeometryShaderID = CompileShader(GL_GEOMETRY_SHADER, geometry_file_path, GeometryShaderCode);
 	}
+	GLuint FragmentShaderID = CompileShader(GL_FRAGMENT_SHADER, fragment_file_path, FragmentShaderCode);
 
-	// Compile Fragment Shader
-    // Same steps as vertex shader
-    // TODO: condense into a single function or loop maybe?
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("Compiling shader : %s\n", fragment_file_path);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
-	}
+    // Init result variables to check return values
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 
 	// Link the program
 	GLuint ProgramID = glCreateProgram();
+	if(retrievable){
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, GeometryShaderID);
+	if(GeometryShaderID != 0){
+		glAttachShader(ProgramID, GeometryShaderID);
+	}
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
 
@@ -150,13 +120,238 @@ GLuint LoadShaders(const char * vertex_file_path, const char * geometry_file_pat
 	glDetachShader(ProgramID, FragmentShaderID);
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
-
-	// printf("Vertex Shader source:\n%s\n", VertexShaderCode.c_str());
-	// printf("Geometry Shader source:\n%s\n", GeometryShaderCode.c_str());
-	// printf("Fragment Shader source:\n%s\n", FragmentShaderCode.c_str());
+	if(GeometryShaderID != 0){
+		glDetachShader(ProgramID, GeometryShaderID);
+		glDeleteShader(GeometryShaderID);
+	}
 
 	return ProgramID;
 }
 
+// Every shader program the scene uses, keyed by its (vertex, geometry, fragment) file paths
+// Each program is compiled once and the same handle is given to everything
+//  that asks for it, so programs live until the context is destroyed.
+// Optionally keeps linked program binaries in a directory on disk, so the
+//  next start can skip compiling altogether. Binaries are keyed by a hash of
+//  the sources and the driver, so editing a shader or updating drivers just
+//  means one more compile.
+class ShaderLibrary {
+	public:
+		// Directory to keep program binaries in, which must already exist
+		// An empty path (the default) turns the binary cache off
+		static void setBinaryCacheDirectory(const std::string &directory)
+		{
+			binaryCacheDirectory() = directory;
+		}
+		// Returns the program for these files, compiling it only the first time it's asked for
+		// geometry_file_path can be NULL for a program without a geometry stage
+		static GLuint get(const char * vertex_file_path, const char * geometry_file_path, const char * fragment_file_path)
+		{
+			Key key(vertex_file_path, geometry_file_path, fragment_file_path);
+			std::map<Key, GLuint>::iterator it = programs().find(key);
+			if(it != programs().end()){
+				counts().shared++;
+				StartupProfiler::count("programs reused", 1);
+				return it->second;
+			}
+
+			ScopedPhase phase("shader program");
+
+			std::string VertexShaderCode, GeometryShaderCode, FragmentShaderCode;
+			if(!ReadShaderFile(vertex_file_path, VertexShaderCode) ||
+				(geometry_file_path != NULL && !ReadShaderFile(geometry_file_path, GeometryShaderCode)) ||
+				!ReadShaderFile(fragment_file_path, FragmentShaderCode)){
+				return 0;
+			}
+
+			bool useBinaries = !binaryCacheDirectory().empty() && binariesSupported();
+			std::string binaryPath;
+			GLuint ProgramID = 0;
+			if(useBinaries){
+				binaryPath = getBinaryPath(VertexShaderCode, GeometryShaderCode, FragmentShaderCode);
+				ProgramID = loadBinary(binaryPath);
+			}
+			if(ProgramID != 0){
+				counts().loaded++;
+			}else{
+				ProgramID = CompileShaderProgram(vertex_file_path, VertexShaderCode,
+					geometry_file_path, GeometryShaderCode,
+					fragment_file_path, FragmentShaderCode,
+					useBinaries);
+				counts().compiled++;
+				if(useBinaries){
+					saveBinary(ProgramID, binaryPath);
+				}
+			}
+			programs()[key] = ProgramID;
+			return ProgramID;
+		}
+		// Programs compiled from source, loaded from a saved binary, and handed out again
+		static int getCompiledCount()
+		{
+			return counts().compiled;
+		}
+		static int getLoadedCount()
+		{
+			return counts().loaded;
+		}
+		static int getSharedCount()
+		{
+			return counts().shared;
+		}
+	private:
+		// (vertex, geometry, fragment) path triple
+		struct Key {
+			Key(const char * vertex, const char * geometry, const char * fragment)
+			{
+				paths[0] = vertex;
+				paths[1] = geometry != NULL ? geometry : "";
+				paths[2] = fragment;
+			}
+			bool operator<(const Key &other) const
+			{
+				for(int i = 0; i < 3; i++){
+					if(paths[i] != other.paths[i]){
+						return paths[i] < other.paths[i];
+					}
+				}
+				return false;
+			}
+			std::string paths[3];
+		};
+		struct Counts {
+			int compiled, loaded, shared;
+		};
+		// Written at the start of every binary file
+		struct BinaryHeader {
+			char magic[4];
+			GLenum format;
+			GLint length;
+		};
+		// Function-local so everything exists before any global object uses it
+		static std::map<Key, GLuint> &programs()
+		{
+			static std::map<Key, GLuint> loaded;
+			return loaded;
+		}
+		static Counts &counts()
+		{
+			static Counts current = {0, 0, 0};
+			return current;
+		}
+		static std::string &binaryCacheDirectory()
+		{
+			static std::string directory;
+			return directory;
+		}
+		// Program binaries need GL 4.1 or ARB_get_program_binary, which a 3.3 context may not have
+		static bool binariesSupported()
+		{
+			static int supported = -1;
+			if(supported < 0){
+				GLint formats = 0;
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+				// Clear the invalid enum error if the query isn't known at all
+				while(glGetError() != GL_NO_ERROR){}
+				supported = formats > 0 ? 1 : 0;
+				if(!supported){
+					std::cerr << "couldn't find program binary support, shader binary cache is off\n";
+				}
+			}
+			return supported == 1;
+		}
+		// FNV-1a, only needs to tell different sources and drivers apart
+		static void hashBytes(uint64_t &hash, const char * bytes, size_t length)
+		{
+			for(size_t i = 0; i < length; i++){
+				hash ^= (unsigned char)bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		}
+		static void hashString(uint64_t &hash, const char * text)
+		{
+			// Include the terminator so "ab"+"c" and "a"+"bc" differ
+			hashBytes(hash, text, strlen(text) + 1);
+		}
+		static std::string getBinaryPath(const std::string &VertexShaderCode, const std::string &GeometryShaderCode, const std::string &FragmentShaderCode)
+		{
+			uint64_t hash = 14695981039346656037ULL;
+			hashString(hash, VertexShaderCode.c_str());
+			hashString(hash, GeometryShaderCode.c_str());
+			hashString(hash, FragmentShaderCode.c_str());
+			// Binaries only work on the driver that made them
+			hashString(hash, (const char*)glGetString(GL_VENDOR));
+			hashString(hash, (const char*)glGetString(GL_RENDERER));
+			hashString(hash, (const char*)glGetString(GL_VERSION));
+
+			char name[32];
+			snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)hash);
+			return binaryCacheDirectory() + "/" + name;
+		}
+		// Returns a linked program from a saved binary, or 0 if there's none or the driver refuses it
+		static GLuint loadBinary(const std::string &path)
+		{
+			ScopedPhase phase("load binary");
+			std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+			if(!file.is_open()){
+				return 0;
+			}
+			BinaryHeader header;
+			file.read((char*)&header, sizeof(header));
+			if(!file || memcmp(header.magic, "SPB1", 4) != 0 || header.length <= 0){
+				return 0;
+			}
+			std::vector<char> binary(header.length);
+			file.read(&binary[0], header.length);
+			if(!file){
+				return 0;
+			}
+
+			GLuint ProgramID = glCreateProgram();
+			glProgramBinary(ProgramID, header.format, &binary[0], header.length);
+			GLint Result = GL_FALSE;
+			glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+			if(Result != GL_TRUE){
+				// Stale binary, it gets compiled and saved over
+				glDeleteProgram(ProgramID);
+				return 0;
+			}
+			StartupProfiler::count("programs loaded from binary", 1);
+			return ProgramID;
+		}
+		static void saveBinary(GLuint ProgramID, const std::string &path)
+		{
+			ScopedPhase phase("save binary");
+			GLint length = 0;
+			glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+			if(length <= 0){
+				return;
+			}
+			std::vector<char> binary(length);
+			BinaryHeader header;
+			memcpy(header.magic, "SPB1", 4);
+			glGetProgramBinary(ProgramID, length, &header.length, &header.format, &binary[0]);
+
+			std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			if(!file.is_open()){
+				std::cerr << "couldn't write shader binary " << path << std::endl;
+				return;
+			}
+			file.write((const char*)&header, sizeof(header));
+			file.write(&binary[0], header.length);
+		}
+};
+
+// Function to load shaders
+// Hands out the shared program for these three files, compiling them the first time
+GLuint LoadShaders(const char * vertex_file_path, const char * geometry_file_path, const char * fragment_file_path)
+{
+	return ShaderLibrary::get(vertex_file_path, geometry_file_path, fragment_file_path);
+}
+// Same, for a program with only vertex and fragment stages
+GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path)
+{
+	return ShaderLibrary::get(vertex_file_path, NULL, fragment_file_path);
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef OFFSCREENTARGET_H
+#define OFFSCREENTARGET_H
+
+//General includes
+#include <iostream>
+
+//Opengl includes
+#include <GL/glew.h>
+
+// Framebuffer object with a color and depth renderbuffer
+// Lets the scene be drawn with no visible window, for headless benchmarks
+class OffscreenTarget {
+    public:
+        OffscreenTarget()
+        {
+            fbo = 0;
+            colorBuffer = 0;
+            depthBuffer = 0;
+            width = 0;
+            height = 0;
+        }
+        // Creates a width x height target, returns false if the driver won't allow it
+        bool init(int newWidth, int newHeight)
+        {
+            width = newWidth;
+            height = newHeight;
+
+            glGenRenderbuffers(1, &colorBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+            glGenRenderbuffers(1, &depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if(status != GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cerr << "couldn't create " << width << "x" << height << " framebuffer, status " << status << std::endl;
+                return false;
+            }
+            return true;
+        }
+        // Sends every following draw into this target
+        void bind()
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, width, height);
+        }
+        int getWidth()
+        {
+            return width;
+        }
+        int getHeight()
+        {
+            return height;
+        }
+    private:
+        GLuint fbo, colorBuffer, depthBuffer;
+        int width, height;
+};
+
+#endif
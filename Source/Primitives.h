@@ -68,6 +68,7 @@ struct Cube {
 // A tetrahedron made of 4 triangles
 struct Tetrahedron {
     public:
+        Tetrahedron(){}
         Tetrahedron(int v0, int v1, int v2, int v3)
         {
             verticesIdx[0] = v0;
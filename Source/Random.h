@@ -0,0 +1,188 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+//General includes
+#include <stdint.h>
+#include <atomic>
+
+// SSE is part of every x86-64 cpu, anything else gets the plain loops
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Seeded random numbers, the same sequence for the same seed and stream on any machine
+// Four xoshiro128+ generators run side by side, so fillBetween() can step all
+// four at once with SSE. Numbers come out of them in turn (lane 0, 1, 2, 3, 0...)
+// whichever way they're asked for, so a fill gives exactly what the same
+// number of next() calls would have, with or without SSE.
+// Each object is one stream and isn't shared between threads: give every
+// thread or every chunk of work its own stream number instead.
+class Random {
+    public:
+        // Fixed stream numbers for work that always draws the same numbers
+        // threadLocal() streams start at firstThreadStream, so they never get one of these
+        static const uint64_t treeStream = 1;
+        static const uint64_t snowStream = 2;
+        static const uint64_t firstThreadStream = (uint64_t)1 << 32;
+
+        Random()
+        {
+            seed(0, 0);
+        }
+        Random(uint64_t seedValue, uint64_t stream)
+        {
+            seed(seedValue, stream);
+        }
+        // Different streams with the same seed never overlap in practice
+        void seed(uint64_t seedValue, uint64_t stream)
+        {
+            // splitmix64 spreads the seed and stream over the whole state
+            uint64_t mix = seedValue ^ (stream * 0x9E3779B97F4A7C15ULL);
+            for(int word = 0; word < 4; word++)
+            {
+                for(int lane = 0; lane < lanes; lane += 2)
+                {
+                    uint64_t bits = splitMix(mix);
+                    state[word][lane] = (uint32_t)bits;
+                    state[word][lane+1] = (uint32_t)(bits >> 32);
+                }
+            }
+            buffered = 0;
+        }
+        uint32_t nextUint()
+        {
+            if(buffered == 0)
+            {
+                step(buffer);
+                buffered = lanes;
+            }
+            return buffer[lanes - buffered--];
+        }
+        // Uniform in [0, 1), 24 bits so every value is exact as a float
+        float nextFloat()
+        {
+            return toUnit(nextUint());
+        }
+        // Uniform between a and b, either can be the larger one
+        float between(float a, float b)
+        {
+            return a + nextFloat()*(b - a);
+        }
+        // Fills out with count numbers between a and b, four at a time
+        void fillBetween(float* out, int count, float a, float b)
+        {
+            float diff = b - a;
+            int i = 0;
+            // Use up anything left from next() calls first, so the order never changes
+            while(buffered > 0 && i < count)
+            {
+                out[i++] = a + nextFloat()*diff;
+            }
+#if defined(__SSE2__)
+            __m128i s0 = _mm_loadu_si128((const __m128i*)state[0]);
+            __m128i s1 = _mm_loadu_si128((const __m128i*)state[1]);
+            __m128i s2 = _mm_loadu_si128((const __m128i*)state[2]);
+            __m128i s3 = _mm_loadu_si128((const __m128i*)state[3]);
+            const __m128 scale = _mm_set1_ps(1.0f/16777216.0f);
+            const __m128 low = _mm_set1_ps(a);
+            const __m128 range = _mm_set1_ps(diff);
+            for(; i + lanes <= count; i += lanes)
+            {
+                // Same steps as step(), one lane per generator
+                __m128i result = _mm_add_epi32(s0, s3);
+                __m128i t = _mm_slli_epi32(s1, 9);
+                s2 = _mm_xor_si128(s2, s0);
+                s3 = _mm_xor_si128(s3, s1);
+                s1 = _mm_xor_si128(s1, s2);
+                s0 = _mm_xor_si128(s0, s3);
+                s2 = _mm_xor_si128(s2, t);
+                s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+                __m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale);
+                _mm_storeu_ps(out + i, _mm_add_ps(low, _mm_mul_ps(unit, range)));
+            }
+            _mm_storeu_si128((__m128i*)state[0], s0);
+            _mm_storeu_si128((__m128i*)state[1], s1);
+            _mm_storeu_si128((__m128i*)state[2], s2);
+            _mm_storeu_si128((__m128i*)state[3], s3);
+#else
+            uint32_t results[lanes];
+            for(; i + lanes <= count; i += lanes)
+            {
+                step(results);
+                for(int lane = 0; lane < lanes; lane++)
+                {
+                    out[i + lane] = a + toUnit(results[lane])*diff;
+                }
+            }
+#endif
+            // Less than four left, the rest of the step waits for the next call
+            for(; i < count; i++)
+            {
+                out[i] = a + nextFloat()*diff;
+            }
+        }
+        // Seed for threadLocal() streams, and reseeds the calling thread's as stream 0
+        // Call it before starting anything that draws numbers on other threads
+        static void setSeed(uint64_t seedValue)
+        {
+            globalSeed() = seedValue;
+            threadLocal().seed(seedValue, 0);
+        }
+        // This thread's own stream, numbered from firstThreadStream in the order threads first ask for one
+        // Only the thread that called setSeed() gets a stream that's the same every run
+        static Random &threadLocal()
+        {
+            static thread_local Random random(globalSeed(), nextStream()++);
+            return random;
+        }
+    private:
+        static const int lanes = 4;
+        uint32_t state[4][lanes];       // state[word][lane], so a word of every generator is one SSE register
+        uint32_t buffer[lanes];         // results of the last step() not handed out yet
+        int buffered;
+
+        // One xoshiro128+ step for each generator, results in lane order
+        void step(uint32_t results[lanes])
+        {
+            for(int lane = 0; lane < lanes; lane++)
+            {
+                uint32_t &s0 = state[0][lane];
+                uint32_t &s1 = state[1][lane];
+                uint32_t &s2 = state[2][lane];
+                uint32_t &s3 = state[3][lane];
+                results[lane] = s0 + s3;
+                uint32_t t = s1 << 9;
+                s2 ^= s0;
+                s3 ^= s1;
+                s1 ^= s2;
+                s0 ^= s3;
+                s2 ^= t;
+                s3 = (s3 << 11) | (s3 >> 21);
+            }
+        }
+        static float toUnit(uint32_t bits)
+        {
+            return (float)(int32_t)(bits >> 8) * (1.0f/16777216.0f);
+        }
+        static uint64_t splitMix(uint64_t &x)
+        {
+            uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        static uint64_t &globalSeed()
+        {
+            static uint64_t seedValue = 0;
+            return seedValue;
+        }
+        // Stream 0 is saved for the thread that calls setSeed(), and the named streams come before these
+        static std::atomic<uint64_t> &nextStream()
+        {
+            static std::atomic<uint64_t> stream(firstThreadStream);
+            return stream;
+        }
+};
+
+#endif
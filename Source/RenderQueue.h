@@ -0,0 +1,154 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+//General includes
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+//Opengl includes
+#include <GL/glew.h>
+
+//Project-specific includes
+#include "GLStateCache.h"
+#include "FrameProfiler.h"
+
+// Every object is drawn as filled faces, a wireframe on top, or both
+// Both can also be drawn in one pass, with the fragment shader finding the
+// edges from each face's barycentric coordinates instead of drawing lines
+enum RenderPass {
+    FacesPass = 0,
+    WireframePass = 1,
+    FacesAndWireframePass = 2
+};
+const int renderPassCount = 3;
+
+// Objects drawing both faces and wireframe use FacesAndWireframePass instead of two passes
+// Read every time passes are picked, so it can change at any time
+inline bool &singlePassWireframe()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+// Fills passes with the passes an object drawing faces and/or wireframe needs, returns how many
+inline int getRenderPasses(bool faces, bool wireframe, RenderPass passes[2])
+{
+    int count = 0;
+    if(faces && wireframe && singlePassWireframe())
+    {
+        passes[count++] = FacesAndWireframePass;
+        return count;
+    }
+    if(faces)
+    {
+        passes[count++] = FacesPass;
+    }
+    if(wireframe)
+    {
+        passes[count++] = WireframePass;
+    }
+    return count;
+}
+
+// colorType the fragment shaders expect for a pass
+// 0 for wireframe, 1 for faces, 2 for faces with their edges drawn on top
+inline int getColorType(RenderPass pass)
+{
+    return pass == WireframePass ? 0 : (pass == FacesPass ? 1 : 2);
+}
+
+// Sets the polygon mode and offset for a pass
+// Wireframes are pushed towards the camera a little so they sit on top of the faces
+inline void setRenderPassState(RenderPass pass)
+{
+    if(pass == WireframePass)
+    {
+        GLStateCache::polygonMode(GL_LINE);
+        GLStateCache::setEnabled(GL_POLYGON_OFFSET_LINE, true);
+        GLStateCache::polygonOffset(0.1, -1);
+    }
+    else
+    {
+        GLStateCache::polygonMode(GL_FILL);
+        GLStateCache::setEnabled(GL_POLYGON_OFFSET_LINE, false);
+    }
+}
+
+class RenderQueue;
+
+// Anything that can be put in a RenderQueue
+class Renderable {
+    public:
+        virtual ~Renderable(){}
+        // Queues this frame's passes
+        virtual void submit(RenderQueue &queue) = 0;
+        // Draws one pass with the matrices from the last update()
+        virtual void drawPass(RenderPass pass) = 0;
+        // Name a pass's draw group is profiled under, must outlive the program (a literal)
+        virtual const char* getProfileName(RenderPass pass) = 0;
+};
+
+// Collects a frame's draws and submits them grouped by pass, then by shader
+// so each polygon mode and program is only switched to once per group.
+// Objects added with the same key keep the order they were added in.
+// Each group is its own profiler zone, timed on the CPU and the GPU.
+class RenderQueue {
+    public:
+        void clear()
+        {
+            items.clear();
+        }
+        void add(GLuint shader, RenderPass pass, Renderable* object)
+        {
+            DrawItem item;
+            item.key = ((uint64_t)pass << 32) | shader;
+            item.order = items.size();
+            item.pass = pass;
+            item.object = object;
+            items.push_back(item);
+        }
+        // Sorts and draws everything added since the last clear()
+        void draw()
+        {
+            std::sort(items.begin(), items.end());
+            for(int i = 0; i < items.size(); i++)
+            {
+                if(i == 0 || items[i].key != items[i-1].key)
+                {
+                    if(i > 0)
+                    {
+                        FrameProfiler::endZone();
+                    }
+                    FrameProfiler::beginZone(items[i].object->getProfileName(items[i].pass), true);
+                }
+                items[i].object->drawPass(items[i].pass);
+            }
+            if(!items.empty())
+            {
+                FrameProfiler::endZone();
+            }
+        }
+        int size()
+        {
+            return items.size();
+        }
+    private:
+        struct DrawItem {
+            uint64_t key;           // pass in the high bits, shader in the low bits
+            int order;              // position it was added in, keeps the sort stable
+            RenderPass pass;
+            Renderable* object;
+            bool operator<(const DrawItem &other) const
+            {
+                if(key != other.key)
+                {
+                    return key < other.key;
+                }
+                return order < other.order;
+            }
+        };
+        std::vector<DrawItem> items;
+};
+
+#endif
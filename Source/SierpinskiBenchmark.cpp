@@ -0,0 +1,154 @@
+//General includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+//Project-specific includes
+#include "SierpinskiMesh.h"
+#include "SierpinskiMeshFile.h"
+
+// Micro-benchmark for sierpinski pyramid generation
+// Times each level on the CPU only, no GL context or window is needed
+// usage: ./SierpinskiBenchmark.out [maxLevel] [repetitions] [threads] [meshDirectory]
+// generateLevel() is run on [threads] threads, 0 means one per core
+// Given a directory, maxLevel is also saved there as a mesh file and read
+// back, against generating and interleaving it from scratch
+int main(int argc, char** argv)
+{
+    int maxLevel = 10;
+    int repetitions = 5;
+    if(argc > 1)
+    {   maxLevel = atoi(argv[1]);   }
+    if(argc > 2)
+    {   repetitions = atoi(argv[2]);    }
+    int threads = 1;
+    if(argc > 3)
+    {   threads = atoi(argv[3]);    }
+
+    JobSystem jobs;
+    jobs.init(threads);
+
+    SierpinskiGenerator generator;
+    generator.init(glm::vec3(0, 0.2, 0));
+
+    // best time of each level over every repetition
+    // subdivide() builds on the previous level, generateLevel() starts from scratch
+    std::vector<double> bestTimes(maxLevel+1, 1e30);
+    std::vector<double> bestDirectTimes(maxLevel+1, 1e30);
+    for(int rep = 0; rep < repetitions; rep++)
+    {
+        generator.reset();
+        for(int level = 1; level <= maxLevel; level++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            generator.subdivide();
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if(ms < bestTimes[level])
+            {   bestTimes[level] = ms;  }
+        }
+        for(int level = 1; level <= maxLevel; level++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            generator.generateLevel(level, &jobs);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if(ms < bestDirectTimes[level])
+            {   bestDirectTimes[level] = ms;    }
+        }
+    }
+
+    printf("direct generation on %d thread(s)\n", jobs.getThreadCount());
+    printf("%5s %12s %12s %12s %12s %14s %12s\n", "level", "tetrahedra", "vertices", "indices", "ms", "ns/tetrahedron", "direct ms");
+    for(int level = 1; level <= maxLevel; level++)
+    {
+        size_t tetrahedra = sierpinskiTetrahedronCount(level);
+        printf("%5d %12zu %12zu %12zu %12.3f %14.2f %12.3f\n",
+            level,
+            tetrahedra,
+            sierpinskiVertexCount(level),
+            sierpinskiIndexCount(level),
+            bestTimes[level],
+            bestTimes[level]*1e6/tetrahedra,
+            bestDirectTimes[level]
+        );
+    }
+
+    // Make sure the generated mesh matches the expected sizes
+    const SierpinskiMesh &mesh = generator.getMesh();
+    if(mesh.vertices.size() != sierpinskiVertexCount(maxLevel) ||
+        mesh.tetrahedrons.size() != sierpinskiTetrahedronCount(maxLevel))
+    {
+        fprintf(stderr, "Generated mesh has the wrong size\n");
+        return 1;
+    }
+
+    if(argc > 4)
+    {
+        SierpinskiMeshFile::setDirectory(argv[4]);
+        glm::vec3 color(0, 0.2, 0);
+        std::vector<float> vertices(sierpinskiIndexCount(maxLevel)*SierpinskiMeshFile::floatsPerVertex);
+        SierpinskiMeshFile file;
+
+        // Everything a run without a file does before uploading
+        double bestGenerateMs = 1e30;
+        for(int rep = 0; rep < repetitions; rep++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            generator.init(color);
+            generator.generateLevel(maxLevel, &jobs);
+            sierpinskiWriteVertices(generator.getMesh(), &vertices[0]);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if(ms < bestGenerateMs)
+            {   bestGenerateMs = ms;    }
+        }
+
+        std::chrono::steady_clock::time_point saveStart = std::chrono::steady_clock::now();
+        float* fileVertices = file.create(maxLevel, color);
+        if(fileVertices == NULL)
+        {
+            fprintf(stderr, "Couldn't create a mesh file in %s\n", argv[4]);
+            return 1;
+        }
+        memcpy(fileVertices, &vertices[0], vertices.size()*sizeof(float));
+        if(!file.finish())
+        {
+            return 1;
+        }
+        file.close();
+        double saveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+
+        // Opening checks every byte against the checksum, so the pages are all touched
+        double bestLoadMs = 1e30;
+        for(int rep = 0; rep < repetitions; rep++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool opened = file.open(maxLevel, color);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if(!opened)
+            {
+                fprintf(stderr, "Couldn't read back the mesh file\n");
+                return 1;
+            }
+            if(ms < bestLoadMs)
+            {   bestLoadMs = ms;    }
+            if(rep < repetitions-1)
+            {   file.close();   }
+        }
+
+        printf("\nlevel %d mesh file, %.1f MB\n", maxLevel, file.getVertexBytes()/(1024.0*1024.0));
+        printf("%12s %12s %12s\n", "generate ms", "save ms", "load ms");
+        printf("%12.3f %12.3f %12.3f\n", bestGenerateMs, saveMs, bestLoadMs);
+
+        if(file.getVertexBytes() != vertices.size()*sizeof(float) ||
+            memcmp(file.getVertices(), &vertices[0], file.getVertexBytes()) != 0)
+        {
+            fprintf(stderr, "Mesh file doesn't match the generated mesh\n");
+            return 1;
+        }
+    }
+    return 0;
+}
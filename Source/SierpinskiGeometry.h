@@ -0,0 +1,490 @@
+#ifndef SIERPINSKIGEOMETRY_H
+#define SIERPINSKIGEOMETRY_H
+
+//General includes
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <iostream>
+#include <cstring>
+
+//Opengl includes
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+//Project-specific includes
+#include "Primitives.h"
+#include "SierpinskiMesh.h"
+#include "SierpinskiMeshFile.h"
+#include "JobSystem.h"
+#include "GLStateCache.h"
+#include "StartupProfiler.h"
+
+// CPU mesh and GPU buffers for one sierpinski pyramid at one level and color
+// Created through SierpinskiGeometryCache so every pyramid with the same
+// level and color shares a single copy.
+// Built in steps so neither the mesh generation nor the upload stalls a frame:
+//   build() generates the CPU mesh, on any thread
+//   finishUpload() maps fresh buffers and hands the copy to a worker, then
+//   unmaps them and fences the upload, and finally reports the geometry as
+//   drawable once the GPU has passed the fence. GL thread only.
+// Whatever was drawn before keeps its own buffers until the swap, so the old
+// level is drawn untouched while the new one streams in.
+// Once uploaded, the VAO holds everything needed to draw: bind it and draw.
+// Every face gets its own three vertices carrying the face's normal, so
+// shaders get flat normals without a geometry stage working them out.
+// With a mesh file directory set, build() maps a saved copy of those vertices
+// instead of generating them, or saves them for next time if there isn't one.
+class SierpinskiGeometry : public std::enable_shared_from_this<SierpinskiGeometry> {
+    public:
+        SierpinskiGeometry(int newLevel, glm::vec3 newColor)
+        {
+            level = newLevel;
+            color = newColor;
+            jobs = NULL;
+            fence = 0;
+            vao = 0;
+            state = Building;
+        }
+        ~SierpinskiGeometry()
+        {
+            // Buffers are already gone if the context was destroyed first
+            // and don't exist at all if the upload never started
+            if(state >= Copying && glfwGetCurrentContext() != NULL)
+            {
+                // Released before the upload finished, the buffer is still mapped
+                if(state == Copying || state == Copied)
+                {
+                    unmapBuffer(vertexBuffer, mappedVertices);
+                }
+                glDeleteBuffers(1, &vertexBuffer);
+                if(vao != 0)
+                {
+                    glDeleteVertexArrays(1, &vao);
+                }
+                if(fence != 0)
+                {
+                    glDeleteSync(fence);
+                }
+            }
+        }
+        // Generates the CPU mesh, splitting the work over jobs if given
+        // Doesn't touch OpenGL, so it's safe on a worker thread
+        void build(JobSystem* jobSystem)
+        {
+            jobs = jobSystem;
+            // Only counted when built on the thread being profiled
+            if(file.open(level, color))
+            {
+                StartupProfiler::count("mesh files loaded", 1);
+            }
+            else
+            {
+                generator.init(color);
+                generator.generateLevel(level, jobs);
+                StartupProfiler::count("tetrahedra generated", sierpinskiTetrahedronCount(level));
+                saveFile();
+            }
+            state = Built;
+        }
+        // Moves the upload along by one step if it can
+        // Returns true once the geometry can be drawn. GL thread only.
+        bool finishUpload()
+        {
+            if(state == Built)
+            {
+                beginUpload();
+            }
+            if(state == Copied)
+            {
+                endUpload();
+            }
+            if(state == Fenced)
+            {
+                GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+                if(result == GL_TIMEOUT_EXPIRED)
+                {
+                    return false;
+                }
+                // A failed wait means the context is gone, nothing left to wait for
+                glDeleteSync(fence);
+                fence = 0;
+                // The GPU has its own copy now, so the CPU one only wastes memory
+                generator.release();
+                state = Ready;
+            }
+            return state == Ready;
+        }
+        bool isBuilt() const
+        {
+            return state >= Built;
+        }
+        bool isUploaded() const
+        {
+            return state == Ready;
+        }
+        // Empty once uploaded, or if the vertices came from a mesh file
+        const SierpinskiMesh &getMesh() const
+        {
+            return generator.getMesh();
+        }
+        // Sizes are known before the mesh is built
+        int getLevel() const
+        {
+            return level;
+        }
+        // Vertices drawn, one for every corner of every face
+        int getVertexCount() const
+        {
+            return sierpinskiIndexCount(level);
+        }
+        // Position at attribute 0, color at attribute 1, face normal at attribute 2
+        // Drawn with glDrawArrays, every three vertices are a face
+        GLuint getVertexArray() const
+        {
+            return vao;
+        }
+        // Interleaved xyz position, rgb color, xyz normal, 9 floats per vertex
+        GLuint getVertexBuffer() const
+        {
+            return vertexBuffer;
+        }
+        static int getVertexStride()
+        {
+            return vertexStride;
+        }
+    private:
+        // Upload steps, in order
+        enum UploadState {
+            Building,   // CPU mesh is being generated
+            Built,      // CPU mesh is done, no buffers yet
+            Copying,    // buffers are mapped and being filled
+            Copied,     // buffers are filled but still mapped
+            Fenced,     // buffers are unmapped, waiting on the GPU
+            Ready       // safe to draw
+        };
+        SierpinskiGenerator generator;
+        SierpinskiMeshFile file;        // open from build() until the upload is done, if files are on
+        GLuint vao, vertexBuffer;
+        GLvoid* mappedVertices;         // interleaved xyz position, rgb color, xyz normal
+        GLsync fence;
+        JobSystem* jobs;                // copies mapped data off the GL thread if set
+        int level;
+        glm::vec3 color;
+        std::atomic<int> state;         // UploadState, advanced by the worker and GL threads
+        // Bytes per vertex: xyz position, rgb color, xyz normal
+        static const int vertexStride = 9*sizeof(GLfloat);
+
+        // Sharing one copy is the whole point, so copying is not allowed
+        SierpinskiGeometry(const SierpinskiGeometry&);
+        SierpinskiGeometry &operator=(const SierpinskiGeometry&);
+
+        // Creates and maps the buffer, then copies into it on a worker
+        void beginUpload()
+        {
+            glGenBuffers(1, &vertexBuffer);
+
+            mappedVertices = mapNewBuffer(vertexBuffer, getVertexCount()*vertexStride);
+            StartupProfiler::count("bytes uploaded", getVertexCount()*vertexStride);
+            state = Copying;
+
+            if(jobs != NULL)
+            {
+                // Skipped if every pyramid let go before it started, the destructor unmaps then
+                // If they let go mid-copy, the job's reference is the last and the cache
+                // hands the delete back to the GL thread
+                std::weak_ptr<SierpinskiGeometry> self = shared_from_this();
+                jobs->submit([self]() {
+                    std::shared_ptr<SierpinskiGeometry> copying = self.lock();
+                    if(copying)
+                    {
+                        copying->copyMappedData();
+                    }
+                });
+            }
+            else
+            {
+                copyMappedData();
+            }
+        }
+        // Storage for a buffer nothing has drawn from yet, so the map never has to wait on the GPU
+        // Bound to the copy target so no VAO's index buffer is disturbed
+        GLvoid* mapNewBuffer(GLuint buffer, GLsizeiptr size)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+            return glMapBufferRange(
+                GL_COPY_WRITE_BUFFER,
+                0,
+                size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+            );
+        }
+        // Writes every face's vertices into the mapped buffer, safe on any thread
+        void copyMappedData()
+        {
+            if(mappedVertices != NULL)
+            {
+                if(file.isOpen())
+                {
+                    // Already laid out, straight from the file's pages into the buffer
+                    memcpy(mappedVertices, file.getVertices(), file.getVertexBytes());
+                }
+                else
+                {
+                    sierpinskiWriteVertices(generator.getMesh(), (GLfloat*)mappedVertices);
+                }
+            }
+            state = Copied;
+        }
+        // Saves the generated vertices for the next run, they're uploaded from the file after that
+        void saveFile()
+        {
+            GLfloat* fileVertices = file.create(level, color);
+            if(fileVertices == NULL)
+            {
+                return;
+            }
+            sierpinskiWriteVertices(generator.getMesh(), fileVertices);
+            if(!file.finish())
+            {
+                file.close();
+            }
+        }
+        // Unmaps the filled buffers, records them in the VAO and fences them
+        void endUpload()
+        {
+            if(!unmapBuffer(vertexBuffer, mappedVertices))
+            {
+                // The driver lost the contents (or never mapped them), start over next time
+                std::cerr << "couldn't upload sierpinski level " << level << ", retrying" << std::endl;
+                glDeleteBuffers(1, &vertexBuffer);
+                state = Built;
+                return;
+            }
+            // Everything is in the buffer now, the file's pages can go
+            file.close();
+            setVertexArray();
+            fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            state = Fenced;
+        }
+        // Records the vertex layout once, so drawing is just binding the VAO
+        void setVertexArray()
+        {
+            glGenVertexArrays(1, &vao);
+            GLStateCache::bindVertexArray(vao);
+            GLStateCache::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+            // Position
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+
+            // Color
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3*sizeof(GLfloat)));
+
+            // Face normal
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6*sizeof(GLfloat)));
+        }
+        bool unmapBuffer(GLuint buffer, GLvoid* mapped)
+        {
+            if(mapped == NULL)
+            {
+                return false;
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+        }
+};
+
+// Process-wide cache of sierpinski geometry, keyed by (level, color)
+// Hands out shared pointers; the cache itself only holds weak pointers,
+// so a level's buffers are freed as soon as the last pyramid moves off it.
+// Only used from the GL thread, meshes are built on workers if a job system is set.
+// A worker job can end up holding the last reference, so a geometry released
+// off the GL thread is queued and deleted by the GL thread's next call in here,
+// where its buffers can actually be deleted.
+class SierpinskiGeometryCache {
+    public:
+        // Worker threads to build meshes on, NULL builds everything on the calling thread
+        static void setJobSystem(JobSystem* jobs)
+        {
+            jobSystem() = jobs;
+        }
+        // Returns the geometry for this level and color, ready to draw
+        // Generates and uploads it on first use, waiting for it if it's still building
+        static std::shared_ptr<SierpinskiGeometry> acquire(int level, glm::vec3 color)
+        {
+            releasePending();
+            std::shared_ptr<SierpinskiGeometry> geometry = find(level, color);
+            if(!geometry)
+            {
+                ScopedPhase phase("mesh generation");
+                geometry = create(level, color);
+                geometry->build(jobSystem());
+            }
+            if(!geometry->isUploaded())
+            {
+                ScopedPhase phase("buffer upload");
+                while(!geometry->finishUpload())
+                {
+                    std::this_thread::yield();
+                }
+            }
+            return geometry;
+        }
+        // Returns the geometry for this level and color right away
+        // A new mesh is built in the background; it can be drawn once finishUpload() returns true
+        static std::shared_ptr<SierpinskiGeometry> request(int level, glm::vec3 color)
+        {
+            releasePending();
+            std::shared_ptr<SierpinskiGeometry> geometry = find(level, color);
+            if(!geometry)
+            {
+                geometry = create(level, color);
+                JobSystem* jobs = jobSystem();
+                if(jobs != NULL)
+                {
+                    // Nothing to build if every pyramid moved off the level before the job started
+                    // If one does while it builds, the job's reference is the last and release() defers it
+                    std::weak_ptr<SierpinskiGeometry> wanted = geometry;
+                    jobs->submit([wanted, jobs]() {
+                        std::shared_ptr<SierpinskiGeometry> building = wanted.lock();
+                        if(building)
+                        {
+                            building->build(jobs);
+                        }
+                    });
+                }
+                else
+                {
+                    geometry->build(NULL);
+                }
+            }
+            return geometry;
+        }
+        // Number of meshes currently held by at least one pyramid
+        static int liveCount()
+        {
+            releasePending();
+            int count = 0;
+            std::map<Key, std::weak_ptr<SierpinskiGeometry> > &cache = entries();
+            std::map<Key, std::weak_ptr<SierpinskiGeometry> >::iterator it = cache.begin();
+            while(it != cache.end())
+            {
+                // Drop entries nobody uses anymore while we're here
+                if(it->second.expired())
+                {
+                    cache.erase(it++);
+                }
+                else
+                {
+                    count++;
+                    it++;
+                }
+            }
+            return count;
+        }
+        // Deletes every geometry whose last reference went away on a worker
+        // GL thread only, cheap when there's nothing queued
+        static void releasePending()
+        {
+            if(pendingCount() == 0)
+            {
+                return;
+            }
+            std::vector<SierpinskiGeometry*> released;
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex());
+                released.swap(pending());
+                pendingCount() = 0;
+            }
+            for(int i = 0; i < released.size(); i++)
+            {
+                delete released[i];
+            }
+        }
+    private:
+        // (level, color) cache key
+        struct Key {
+            Key(int l, glm::vec3 c)
+            {
+                level = l;
+                color = c;
+            }
+            bool operator<(const Key &other) const
+            {
+                if(level != other.level)    { return level < other.level; }
+                if(color.x != other.color.x){ return color.x < other.color.x; }
+                if(color.y != other.color.y){ return color.y < other.color.y; }
+                return color.z < other.color.z;
+            }
+            int level;
+            glm::vec3 color;
+        };
+        static std::shared_ptr<SierpinskiGeometry> find(int level, glm::vec3 color)
+        {
+            return entries()[Key(level, color)].lock();
+        }
+        static std::shared_ptr<SierpinskiGeometry> create(int level, glm::vec3 color)
+        {
+            // Every geometry is created here first, always on the GL thread and before any job can release one
+            if(glThread() == std::thread::id())
+            {
+                glThread() = std::this_thread::get_id();
+            }
+            std::shared_ptr<SierpinskiGeometry> geometry(new SierpinskiGeometry(level, color), release);
+            entries()[Key(level, color)] = geometry;
+            return geometry;
+        }
+        // Deleter for every geometry handed out, called by whichever thread drops the last reference
+        static void release(SierpinskiGeometry* geometry)
+        {
+            if(std::this_thread::get_id() == glThread())
+            {
+                delete geometry;
+                return;
+            }
+            std::lock_guard<std::mutex> lock(pendingMutex());
+            pending().push_back(geometry);
+            pendingCount()++;
+        }
+        static std::thread::id &glThread()
+        {
+            static std::thread::id id;
+            return id;
+        }
+        static std::vector<SierpinskiGeometry*> &pending()
+        {
+            static std::vector<SierpinskiGeometry*> released;
+            return released;
+        }
+        static std::atomic<int> &pendingCount()
+        {
+            static std::atomic<int> count(0);
+            return count;
+        }
+        static std::mutex &pendingMutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+        static JobSystem* &jobSystem()
+        {
+            static JobSystem* jobs = NULL;
+            return jobs;
+        }
+        // Function-local so the map exists before any global pyramid uses it
+        static std::map<Key, std::weak_ptr<SierpinskiGeometry> > &entries()
+        {
+            static std::map<Key, std::weak_ptr<SierpinskiGeometry> > cache;
+            return cache;
+        }
+};
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef SIERPINSKIMESH_H
+#define SIERPINSKIMESH_H
+
+//General includes
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+//Opengl includes
+// Only glm is needed here, so the generator can run without a GL context
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+
+//Project-specific includes
+#include "Primitives.h"
+#include "JobSystem.h"
+
+// Exact sizes of a sierpinski pyramid at a given level
+// Every subdivision turns each tetrahedron into 4, and adds 6 vertices
+// (one per edge) for each tetrahedron it splits.
+// Sibling tetrahedrons only ever touch at corners, so no edge is shared
+// and none of those midpoints are duplicates.
+size_t sierpinskiTetrahedronCount(int level)
+{
+    return (size_t)1 << (2*level);      // 4^level
+}
+size_t sierpinskiVertexCount(int level)
+{
+    return 2*sierpinskiTetrahedronCount(level) + 2;
+}
+size_t sierpinskiIndexCount(int level)
+{
+    return 12*sierpinskiTetrahedronCount(level);    // 4 faces * 3 indices
+}
+
+// Corners of the level 0 pyramid, every later level fits inside them
+void sierpinskiBaseVertices(glm::vec3 vertices[4])
+{
+    // A transformation to rotate initial tetrahedron to a more normal orientation
+    glm::mat4 pointUpMatrix = glm::rotate(glm::radians(-90.0f), glm::vec3(1, 0, 0));
+    glm::vec4 baseVerts[4] = {
+        pointUpMatrix * glm::vec4(0.0, 0.0, 1, 0),
+        pointUpMatrix * glm::vec4(0.0, 0.942809, -0.33333, 0),
+        pointUpMatrix * glm::vec4(-0.816497, -0.471405, -0.333333, 0),
+        pointUpMatrix * glm::vec4(0.816497, -0.471405, -0.333333, 0)
+    };
+    for(int i = 0; i < 4; i++)
+    {
+        vertices[i] = glm::vec3(baseVerts[i].x, baseVerts[i].y, baseVerts[i].z);
+    }
+}
+
+// CPU-side data for a single level of a sierpinski pyramid
+struct SierpinskiMesh {
+    public:
+        SierpinskiMesh()
+        {
+            level = 0;
+        }
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> colors;
+        std::vector<Tetrahedron> tetrahedrons;
+        int level;
+};
+
+// Normal of a CCW face, same as breathingShader.geo.glsl works out
+glm::vec3 sierpinskiFaceNormal(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2)
+{
+    return glm::normalize(glm::cross(v2 - v1, v0 - v1));
+}
+// Writes the mesh the way it's uploaded: every face's three corners in order,
+// each as xyz position, rgb color and xyz face normal (9 floats).
+// Interleaved so each vertex is one contiguous read for the GPU.
+// vertexData needs room for sierpinskiIndexCount(level)*9 floats.
+void sierpinskiWriteVertices(const SierpinskiMesh &mesh, float* vertexData)
+{
+    for(int i = 0; i < mesh.tetrahedrons.size(); i++)
+    {
+        for(int j = 0; j < 4; j++)      //j < 4 (faces per tetrahedron)
+        {
+            const glm::ivec3 &face = mesh.tetrahedrons[i].faces[j];
+            int corners[3] = { face.x, face.y, face.z };
+            glm::vec3 normal = sierpinskiFaceNormal(mesh.vertices[face.x], mesh.vertices[face.y], mesh.vertices[face.z]);
+            for(int k = 0; k < 3; k++)
+            {
+                //      [i*12 vertices per tetrahedron + j*3 vertices per face + k] * 9 floats per vertex
+                float* vertex = vertexData + ((i*12) + (j*3) + k)*9;
+                const glm::vec3 &position = mesh.vertices[corners[k]];
+                const glm::vec3 &vertexColor = mesh.colors[corners[k]];
+                vertex[0] = position.x;
+                vertex[1] = position.y;
+                vertex[2] = position.z;
+                vertex[3] = vertexColor.x;
+                vertex[4] = vertexColor.y;
+                vertex[5] = vertexColor.z;
+                vertex[6] = normal.x;
+                vertex[7] = normal.y;
+                vertex[8] = normal.z;
+            }
+        }
+    }
+}
+
+// Generates sierpinski pyramids one level at a time
+// Holds two meshes: the current level is read from the front mesh while the
+// next level is written into the back mesh, then the two are swapped.
+// The back mesh keeps its storage between levels, so after the first few
+// subdivisions no memory is allocated at all.
+class SierpinskiGenerator {
+    public:
+        SierpinskiGenerator()
+        {
+            front = 0;
+            objectColor = glm::vec3(1, 1, 1);
+        }
+        void init(glm::vec3 color)
+        {
+            objectColor = color;
+            reset();
+        }
+        // Resets front mesh to a default pyramid
+        void reset()
+        {
+            SierpinskiMesh &mesh = buffers[front];
+            mesh.level = 0;
+            mesh.vertices.resize(sierpinskiVertexCount(0));
+            mesh.colors.resize(sierpinskiVertexCount(0));
+            mesh.tetrahedrons.resize(sierpinskiTetrahedronCount(0));
+
+            sierpinskiBaseVertices(&mesh.vertices[0]);
+            for(int i = 0; i < 4; i++)
+            {
+                mesh.colors[i] = getColor(mesh.vertices[i]);
+            }
+
+            mesh.tetrahedrons[0] = Tetrahedron(0, 1, 2, 3);
+        }
+        // Generates the next level from the front mesh into the back mesh,
+        // then makes the back mesh the front
+        void subdivide()
+        {
+            const SierpinskiMesh &src = buffers[front];
+            SierpinskiMesh &dst = buffers[1-front];
+
+            int srcVertCount = src.vertices.size();
+            int srcTetCount = src.tetrahedrons.size();
+
+            // Size everything exactly once
+            dst.level = src.level+1;
+            dst.vertices.resize(sierpinskiVertexCount(dst.level));
+            dst.colors.resize(sierpinskiVertexCount(dst.level));
+            dst.tetrahedrons.resize(sierpinskiTetrahedronCount(dst.level));
+
+            // Every existing vertex is still a corner of some new tetrahedron
+            std::copy(src.vertices.begin(), src.vertices.end(), dst.vertices.begin());
+            std::copy(src.colors.begin(), src.colors.end(), dst.colors.begin());
+
+            // Parent i owns midpoint slots [srcVertCount + 6i, srcVertCount + 6i + 6)
+            // and child slots [4i, 4i + 4), so no pushing or erasing is needed
+            for(int i = 0; i < srcTetCount; i++)
+            {
+                // Save vertex indices for clarity
+                int v0 = src.tetrahedrons[i].verticesIdx[0];
+                int v1 = src.tetrahedrons[i].verticesIdx[1];
+                int v2 = src.tetrahedrons[i].verticesIdx[2];
+                int v3 = src.tetrahedrons[i].verticesIdx[3];
+
+                // Create vertices at midpoint of each edge
+                int v4 = srcVertCount + i*6;
+                int v5 = v4+1;
+                int v6 = v4+2;
+                int v7 = v4+3;
+                int v8 = v4+4;
+                int v9 = v4+5;
+                setMidpoint(dst, v4, v0, v1);
+                setMidpoint(dst, v5, v1, v2);
+                setMidpoint(dst, v6, v2, v0);
+                setMidpoint(dst, v7, v0, v3);
+                setMidpoint(dst, v8, v1, v3);
+                setMidpoint(dst, v9, v2, v3);
+
+                // Replace parent with 4 new tetrahedrons
+                dst.tetrahedrons[i*4+0] = Tetrahedron(v0, v6, v7, v4);
+                dst.tetrahedrons[i*4+1] = Tetrahedron(v1, v8, v5, v4);
+                dst.tetrahedrons[i*4+2] = Tetrahedron(v2, v9, v6, v5);
+                dst.tetrahedrons[i*4+3] = Tetrahedron(v3, v9, v8, v7);
+            }
+
+            front = 1-front;
+        }
+        // Generates the requested level directly from the base tetrahedron
+        // into the back mesh, then makes the back mesh the front.
+        // Each final tetrahedron is found by walking its base-4 address
+        // (one digit per level, most significant first) down from the base
+        // tetrahedron, so no intermediate level is ever stored or copied.
+        // The result is identical to calling subdivide() level times.
+        // Given a job system, ranges of addresses are generated on separate threads.
+        void generateLevel(int level, JobSystem* jobs = NULL)
+        {
+            // Start from the base tetrahedron
+            reset();
+            if(level <= 0)
+            {
+                return;
+            }
+            const SierpinskiMesh &base = buffers[front];
+            SierpinskiMesh &dst = buffers[1-front];
+
+            dst.level = level;
+            dst.vertices.resize(sierpinskiVertexCount(level));
+            dst.colors.resize(sierpinskiVertexCount(level));
+            dst.tetrahedrons.resize(sierpinskiTetrahedronCount(level));
+            std::copy(base.vertices.begin(), base.vertices.end(), dst.vertices.begin());
+            std::copy(base.colors.begin(), base.colors.end(), dst.colors.begin());
+
+            int tetCount = sierpinskiTetrahedronCount(level);
+            if(jobs != NULL)
+            {
+                jobs->parallelFor(tetCount, 1024, [this, &base, &dst, level](int begin, int end) {
+                    generateRange(base, dst, level, begin, end);
+                });
+            }
+            else
+            {
+                generateRange(base, dst, level, 0, tetCount);
+            }
+
+            front = 1-front;
+        }
+        // Current level
+        const SierpinskiMesh &getMesh() const
+        {
+            return buffers[front];
+        }
+        int getLevel() const
+        {
+            return buffers[front].level;
+        }
+        // Frees both meshes, reset() or generateLevel() starts over from nothing
+        void release()
+        {
+            for(int i = 0; i < 2; i++)
+            {
+                std::vector<glm::vec3>().swap(buffers[i].vertices);
+                std::vector<glm::vec3>().swap(buffers[i].colors);
+                std::vector<Tetrahedron>().swap(buffers[i].tetrahedrons);
+                buffers[i].level = 0;
+            }
+        }
+    private:
+        SierpinskiMesh buffers[2];
+        int front;                  // index of the mesh holding the current level
+        glm::vec3 objectColor;      // Color for the base shape
+
+        // generates a color based on object color and a passed vertex position
+        glm::vec3 getColor(const glm::vec3 &vertexPos) const
+        {
+            static float colorMultiplier = 2;
+            return objectColor + objectColor*colorMultiplier*vertexPos.y;
+        }
+        // Generates tetrahedrons [begin, end) of the given level into dst
+        // Every vertex is written by exactly one address, so separate ranges
+        // never write to the same memory
+        void generateRange(const SierpinskiMesh &base, SierpinskiMesh &dst, int level, size_t begin, size_t end) const
+        {
+            // Edges of a tetrahedron, in the order their midpoints are stored
+            static const int edges[6][2] = {
+                {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3}
+            };
+            // Corners of each child, 0-3 are parent corners and 4-9 are edge midpoints
+            static const int children[4][4] = {
+                {0, 6, 7, 4}, {1, 8, 5, 4}, {2, 9, 6, 5}, {3, 9, 8, 7}
+            };
+
+            // Ancestor of the current tetrahedron at every depth, depth 0 is the base
+            // Consecutive addresses share all but their last few digits, so only
+            // the ancestors below the deepest changed digit are recomputed
+            std::vector<int> corners((level+1)*4);
+            std::vector<glm::vec3> positions((level+1)*4);
+            std::vector<size_t> ancestors(level+1);
+            for(int i = 0; i < 4; i++)
+            {
+                corners[i] = i;
+                positions[i] = base.vertices[i];
+            }
+            ancestors[0] = 0;
+
+            for(size_t t = begin; t < end; t++)
+            {
+                // Find the shallowest digit that changed since the previous address
+                // The first address of the range has no previous one, so walk all of it
+                int changed = level;
+                while(changed > 1 && (t == begin || ((t >> 2*(level-changed)) & 3) == 0))
+                {
+                    changed--;
+                }
+
+                for(int l = changed; l <= level; l++)
+                {
+                    int digit = (t >> 2*(level-l)) & 3;
+                    const int *parentCorners = &corners[(l-1)*4];
+                    const glm::vec3 *parentPositions = &positions[(l-1)*4];
+
+                    // Midpoint slots of the parent, same layout as subdivide()
+                    int midpoints[6];
+                    glm::vec3 midpointPositions[6];
+                    int firstMidpoint = sierpinskiVertexCount(l-1) + ancestors[l-1]*6;
+                    for(int e = 0; e < 6; e++)
+                    {
+                        midpoints[e] = firstMidpoint + e;
+                        midpointPositions[e] = (parentPositions[edges[e][0]] + parentPositions[edges[e][1]])/2.0f;
+                    }
+                    // The parent's first descendant (every remaining digit 0) writes its midpoints
+                    if((t & (((size_t)4 << 2*(level-l)) - 1)) == 0)
+                    {
+                        for(int e = 0; e < 6; e++)
+                        {
+                            dst.vertices[midpoints[e]] = midpointPositions[e];
+                            dst.colors[midpoints[e]] = getColor(midpointPositions[e]);
+                        }
+                    }
+
+                    // Step down into the child picked by this digit
+                    for(int i = 0; i < 4; i++)
+                    {
+                        int corner = children[digit][i];
+                        if(corner < 4)
+                        {
+                            corners[l*4+i] = parentCorners[corner];
+                            positions[l*4+i] = parentPositions[corner];
+                        }
+                        else
+                        {
+                            corners[l*4+i] = midpoints[corner-4];
+                            positions[l*4+i] = midpointPositions[corner-4];
+                        }
+                    }
+                    ancestors[l] = ancestors[l-1]*4 + digit;
+                }
+
+                const int *leaf = &corners[level*4];
+                dst.tetrahedrons[t] = Tetrahedron(leaf[0], leaf[1], leaf[2], leaf[3]);
+            }
+        }
+        // Places the midpoint of vertices a and b (and its color) in slot index
+        void setMidpoint(SierpinskiMesh &mesh, int index, int a, int b) const
+        {
+            glm::vec3 newVert = (mesh.vertices[a] + mesh.vertices[b])/2.0f;
+            mesh.vertices[index] = newVert;
+            mesh.colors[index] = getColor(newVert);
+        }
+};
+
+#endif
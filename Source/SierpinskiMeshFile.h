@@ -0,0 +1,367 @@
+#ifndef SIERPINSKIMESHFILE_H
+#define SIERPINSKIMESHFILE_H
+
+//General includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// Files are mapped straight into memory where the OS can do it,
+// anything else reads them into a buffer instead
+#if defined(__unix__) || defined(__APPLE__)
+#define SIERPINSKI_MESH_FILE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Opengl includes
+// Only glm is needed here, so files can be read and written without a GL context
+#include <glm/glm.hpp>
+
+//Project-specific includes
+#include "SierpinskiMesh.h"
+
+// Uploadable vertex data for one sierpinski level and color, saved to disk
+// so the next run can skip generating it.
+// One file per (level, color): a 48 byte header, then the vertices exactly as
+// SierpinskiGeometry uploads them (xyz position, rgb color, xyz face normal,
+// every face corner in order). Everything is little-endian; on a big-endian
+// machine the files are never used, the mesh is just generated every time.
+// open() maps the file read-only and getVertices() points into that mapping,
+// so the upload copies straight from the page cache with nothing in between.
+// A file whose header doesn't match or whose checksum is wrong is ignored
+// and written over.
+class SierpinskiMeshFile {
+    public:
+        static const int floatsPerVertex = 9;
+
+        SierpinskiMeshFile()
+        {
+            mapping = NULL;
+            mappedSize = 0;
+            vertexCount = 0;
+        }
+        ~SierpinskiMeshFile()
+        {
+            close();
+        }
+        // Files are read from and saved in this directory, empty (the default) turns them off
+        static void setDirectory(const std::string &directory)
+        {
+            fileDirectory() = directory;
+        }
+        static bool isEnabled()
+        {
+            return !fileDirectory().empty() && hostIsLittleEndian();
+        }
+        // Maps the saved file for this level and color
+        // Returns false if there isn't one or it's stale or damaged
+        bool open(int level, glm::vec3 color)
+        {
+            close();
+            if(!isEnabled())
+            {
+                return false;
+            }
+            std::string path = getPath(level, color);
+            if(!mapForReading(path))
+            {
+                return false;
+            }
+            const Header* header = (const Header*)mapping;
+            if(!headerMatches(*header, level, color) ||
+                mappedSize != sizeof(Header) + header->payloadBytes ||
+                header->checksum != checksum(getPayload(), header->payloadBytes))
+            {
+                std::cerr << "couldn't use mesh file " << path << ", it will be regenerated" << std::endl;
+                close();
+                return false;
+            }
+            vertexCount = header->vertexCount;
+            return true;
+        }
+        // Starts a new file for this level and color, returns where its vertices go
+        // Written to a temporary name, so nothing can open it half done
+        // Fill in every vertex, then call finish(). NULL if the file can't be made.
+        float* create(int level, glm::vec3 color)
+        {
+            close();
+            if(!isEnabled())
+            {
+                return NULL;
+            }
+            size_t vertices = sierpinskiIndexCount(level);
+            if(!mapForWriting(getPath(level, color) + ".tmp", sizeof(Header) + vertices*vertexBytes))
+            {
+                return NULL;
+            }
+            Header* header = (Header*)mapping;
+            memcpy(header->magic, "SPM1", 4);
+            header->level = level;
+            header->vertexCount = vertices;
+            header->indexCount = 0;
+            header->layout = layoutPositionColorNormal;
+            header->color[0] = color.x;
+            header->color[1] = color.y;
+            header->color[2] = color.z;
+            header->checksum = 0;
+            header->reserved = 0;
+            header->payloadBytes = vertices*vertexBytes;
+            vertexCount = vertices;
+            return (float*)getPayload();
+        }
+        // Checksums the vertices written since create() and moves the file into place
+        // The vertices stay readable through getVertices() until close()
+        bool finish()
+        {
+            if(writePath.empty())
+            {
+                return false;
+            }
+            Header* header = (Header*)mapping;
+            header->checksum = checksum(getPayload(), header->payloadBytes);
+            std::string tempPath = writePath;
+            std::string path = tempPath.substr(0, tempPath.size() - 4);
+            writePath.clear();
+            if(!flushWritten(tempPath) || rename(tempPath.c_str(), path.c_str()) != 0)
+            {
+                std::cerr << "couldn't save mesh file " << path << std::endl;
+                remove(tempPath.c_str());
+                return false;
+            }
+            return true;
+        }
+        void close()
+        {
+            if(!writePath.empty())
+            {
+                // create() without finish(), don't leave a partial file behind
+                remove(writePath.c_str());
+                writePath.clear();
+            }
+#if defined(SIERPINSKI_MESH_FILE_MMAP)
+            if(mapping != NULL)
+            {
+                munmap(mapping, mappedSize);
+            }
+#else
+            std::vector<char>().swap(buffer);
+#endif
+            mapping = NULL;
+            mappedSize = 0;
+            vertexCount = 0;
+        }
+        bool isOpen() const
+        {
+            return mapping != NULL;
+        }
+        // Interleaved vertices, floatsPerVertex floats each
+        const float* getVertices() const
+        {
+            return (const float*)getPayload();
+        }
+        size_t getVertexCount() const
+        {
+            return vertexCount;
+        }
+        size_t getVertexBytes() const
+        {
+            return vertexCount*vertexBytes;
+        }
+    private:
+        // Start of every file, 48 bytes
+        // reserved keeps payloadBytes 8-byte aligned on every ABI, so nothing is left to the compiler
+        struct Header {
+            char magic[4];          // "SPM1", bumped whenever the layout of the file changes
+            uint32_t level;
+            uint32_t vertexCount;
+            uint32_t indexCount;    // always 0, every face has its own three vertices
+            uint32_t layout;        // floats per attribute, one hex digit each
+            float color[3];         // the base color the mesh was generated with
+            uint32_t checksum;      // of the payload, see checksum()
+            uint32_t reserved;      // always 0
+            uint64_t payloadBytes;
+        };
+        static_assert(sizeof(Header) == 48, "SierpinskiMeshFile::Header must match the file format");
+        static const uint32_t layoutPositionColorNormal = 0x333;
+        static const size_t vertexBytes = floatsPerVertex*sizeof(float);
+
+        void* mapping;              // header followed by the payload
+        size_t mappedSize;
+        size_t vertexCount;
+        std::string writePath;      // temporary file between create() and finish()
+#if !defined(SIERPINSKI_MESH_FILE_MMAP)
+        std::vector<char> buffer;   // stands in for the mapping
+#endif
+
+        // One file is one mapping, so copying is not allowed
+        SierpinskiMeshFile(const SierpinskiMeshFile&);
+        SierpinskiMeshFile &operator=(const SierpinskiMeshFile&);
+
+        const char* getPayload() const
+        {
+            return (const char*)mapping + sizeof(Header);
+        }
+        bool headerMatches(const Header &header, int level, glm::vec3 color) const
+        {
+            float expectedColor[3] = { color.x, color.y, color.z };
+            return memcmp(header.magic, "SPM1", 4) == 0 &&
+                header.level == (uint32_t)level &&
+                header.vertexCount == sierpinskiIndexCount(level) &&
+                header.indexCount == 0 &&
+                header.layout == layoutPositionColorNormal &&
+                header.reserved == 0 &&
+                memcmp(header.color, expectedColor, sizeof(expectedColor)) == 0 &&
+                header.payloadBytes == header.vertexCount*vertexBytes;
+        }
+#if defined(SIERPINSKI_MESH_FILE_MMAP)
+        bool mapForReading(const std::string &path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+            {
+                return false;
+            }
+            struct stat info;
+            void* mapped = MAP_FAILED;
+            if(fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(Header))
+            {
+                mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            // The mapping keeps the file alive by itself
+            ::close(fd);
+            if(mapped == MAP_FAILED)
+            {
+                return false;
+            }
+            mapping = mapped;
+            mappedSize = info.st_size;
+            return true;
+        }
+        bool mapForWriting(const std::string &path, size_t size)
+        {
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if(fd < 0)
+            {
+                std::cerr << "couldn't create mesh file " << path << std::endl;
+                return false;
+            }
+            void* mapped = MAP_FAILED;
+            if(ftruncate(fd, size) == 0)
+            {
+                mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if(mapped == MAP_FAILED)
+            {
+                std::cerr << "couldn't map mesh file " << path << std::endl;
+                remove(path.c_str());
+                return false;
+            }
+            mapping = mapped;
+            mappedSize = size;
+            writePath = path;
+            return true;
+        }
+        // The mapping is shared with the file, so it only has to reach the disk
+        bool flushWritten(const std::string &path)
+        {
+            return msync(mapping, mappedSize, MS_SYNC) == 0;
+        }
+#else
+        bool mapForReading(const std::string &path)
+        {
+            std::ifstream file(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+            if(!file.is_open())
+            {
+                return false;
+            }
+            std::streamoff size = file.tellg();
+            if(size < (std::streamoff)sizeof(Header))
+            {
+                return false;
+            }
+            buffer.resize(size);
+            file.seekg(0);
+            if(!file.read(&buffer[0], size))
+            {
+                std::vector<char>().swap(buffer);
+                return false;
+            }
+            mapping = &buffer[0];
+            mappedSize = size;
+            return true;
+        }
+        bool mapForWriting(const std::string &path, size_t size)
+        {
+            buffer.resize(size);
+            mapping = &buffer[0];
+            mappedSize = size;
+            writePath = path;
+            return true;
+        }
+        bool flushWritten(const std::string &path)
+        {
+            std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            if(!file.is_open())
+            {
+                return false;
+            }
+            return (bool)file.write(&buffer[0], mappedSize);
+        }
+#endif
+        // Fletcher-style sum over 32-bit words, catches truncated or damaged files
+        // It reads every byte once, so it costs next to nothing next to regenerating
+        static uint32_t checksum(const char* data, size_t size)
+        {
+            uint64_t sum = 1;
+            uint64_t sumOfSums = 0;
+            size_t words = size/4;
+            for(size_t i = 0; i < words; i++)
+            {
+                uint32_t word;
+                memcpy(&word, data + i*4, 4);
+                sum += word;
+                sumOfSums += sum;
+            }
+            for(size_t i = words*4; i < size; i++)
+            {
+                sum += (unsigned char)data[i];
+                sumOfSums += sum;
+            }
+            return (uint32_t)(sum ^ sumOfSums ^ (sumOfSums >> 32));
+        }
+        static bool hostIsLittleEndian()
+        {
+            uint16_t probe = 1;
+            unsigned char firstByte;
+            memcpy(&firstByte, &probe, 1);
+            return firstByte == 1;
+        }
+        // Named after the level and the exact bits of the color
+        static std::string getPath(int level, glm::vec3 color)
+        {
+            uint32_t bits[3];
+            memcpy(&bits[0], &color.x, 4);
+            memcpy(&bits[1], &color.y, 4);
+            memcpy(&bits[2], &color.z, 4);
+            char name[64];
+            snprintf(name, sizeof(name), "sierpinski_L%d_%08x%08x%08x.mesh", level, bits[0], bits[1], bits[2]);
+            return fileDirectory() + "/" + name;
+        }
+        // Function-local so it's set before any global pyramid builds a mesh
+        static std::string &fileDirectory()
+        {
+            static std::string directory;
+            return directory;
+        }
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <math.h>
 
 //Opengl includes
@@ -18,19 +20,24 @@
 //Project-specific includes
 #include "LoadShaders.h"
 #include "Primitives.h"
+#include "SierpinskiMesh.h"
+#include "SierpinskiGeometry.h"
 #include "UsefulFunctions.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "BoundingVolumes.h"
+#include "FrameUniforms.h"
 
 // SierpinskiPyramid class
-class SierpinskiPyramid {
+class SierpinskiPyramid : public Renderable {
     public:
         SierpinskiPyramid(){}
         void init(GLFWwindow* window, glm::vec3 position, glm::mat4 scale, glm::mat4 rotation, glm::vec3 color)
         {
             renderFaces = true;
             renderWireframe = true;
-            objectColor = color;
+            lodEnabled = true;
             rotationFactor = randomBetween(-1, 1);
-            level = 0;
 
             // Set up modelMatrix as identity matrix for now
             defaultPosition = position;
@@ -38,100 +45,115 @@ class SierpinskiPyramid {
             scalingMatrix = scale;
             translationMatrix = glm::translate(position);
             rotationMatrix = rotation;
+            modelDirty = true;
 
-            // Generate initial point data
-            resetPyramid();
+            // Use the shared level 0 pyramid for this color
+            objectColor = color;
+            generateLevel(0);
 
-            // // Load and compile shaders
-            pyramidShader = LoadShaders("passthrough.vrt.glsl", "breathingShader.geo.glsl", "breathingShader.frg.glsl");
+            // Load and compile shaders
+            // Normals come from the mesh and breathing is done per vertex, unless the old path was asked for
+            if(useGeometryShader())
+            {
+                pyramidShader = LoadShaders("passthrough.vrt.glsl", "breathingShader.geo.glsl", "breathingShader.frg.glsl");
+            }
+            else
+            {
+                pyramidShader = LoadShaders("breathingShader.vrt.glsl", "breathingShader.frg.glsl");
+            }
             glUseProgram(pyramidShader);
 
-            // initialize MVP Matrix array reference in shader
-            MVPMatrices_ref = glGetUniformLocation(pyramidShader, "matrices");
-            if(MVPMatrices_ref < 0)
-            {   std::cerr << "couldn't find MVP matrices in shader\n";  }
+            // View, projection and the breathing timer come from the frame's uniform buffer
+            FrameUniforms::bindProgram(pyramidShader);
+
+            // initialize model matrix reference in shader
+            modelMatrixRef = glGetUniformLocation(pyramidShader, "modelMatrix");
+            if(modelMatrixRef < 0)
+            {   std::cerr << "couldn't find modelMatrix in shader\n";  }
+
+            // initialize normal matrix reference in shader
+            // The geometry shader works normals out itself and doesn't have one
+            normalMatrixRef = -1;
+            if(!useGeometryShader())
+            {
+                normalMatrixRef = glGetUniformLocation(pyramidShader, "normalMatrix");
+                if(normalMatrixRef < 0)
+                {   std::cerr << "couldn't find normalMatrix in shader\n";  }
+            }
 
             // initialize colorType reference in shaders
             // Used to switch colorTypes in the shader at runtime
             colorTypeRef = glGetUniformLocation(pyramidShader, "colorType");
             if(colorTypeRef < 0)
             {   std::cerr<< "couldn't find colorType in shader\n"; }
-
-            // initialize geoTimer reference in shaders
-            // For breathing effect
-            geoTimerRef = glGetUniformLocation(pyramidShader, "geoTimer");
-            if(geoTimerRef < 0)
-            {   std::cerr<< "couldn't find geoTimer in shader\n"; }
-
-            // Generate VAO
-            glGenVertexArrays(1, &vao);
-            glBindVertexArray(vao);
-
-            // Generate VBO, IBO, and color buffers
-            glGenBuffers(1, &positionBuffer);
-            glGenBuffers(1, &ibo);
-            glGenBuffers(1, &colorBuffer);
-
-            setVertexBufferData();
-            setColorBufferData();
-            setIndexBufferData();
+        }
+        // Rebuilds the model matrix if the pyramid moved and picks a level, without touching OpenGL
+        // Safe to call for different objects from different threads
+        void update(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+        {
+            updateModelMatrix();
+            lodLevel = lodEnabled ? selectLodLevel(viewMatrix, projectionMatrix) : detailLevel;
         }
         // draw function
         // Draws every triangle in the vertexbuffer with a color corresponding to the colorbuffer
-        void draw(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+        // Uses the model matrix from the last update() and the frame's view and projection
+        void draw()
         {
-            // Swap to necessary shader
-            glUseProgram(pyramidShader);
+            // Switch to a newly picked level as soon as it's ready
+            swapInLodGeometry();
 
-            // Bind IBO
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-
-            // Bind VBO
-            glEnableVertexAttribArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
-            glVertexAttribPointer(
-                0,
-                3,
-                GL_FLOAT,
-                GL_FALSE,
-                0,
-                (void*)0
-            );
+            // draw triangle faces and/or wireframe, in one pass if single-pass wireframe is on
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                drawPass(passes[i]);
+            }
+        }
+        // Queues this frame's passes instead of drawing them right away
+        void submit(RenderQueue &queue)
+        {
+            // Both passes have to draw the same level
+            swapInLodGeometry();
 
-            // Bind color buffer
-            glEnableVertexAttribArray(1);
-            glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-            glVertexAttribPointer(
-                1,
-                3,
-                GL_FLOAT,
-                GL_FALSE,
-                0,
-                (void*)0
-            );
+            RenderPass passes[2];
+            int passCount = getRenderPasses(renderFaces, renderWireframe, passes);
+            for(int i = 0; i < passCount; i++)
+            {
+                queue.add(pyramidShader, passes[i], this);
+            }
+        }
+        // Draws a single pass, only state that differs from the last draw is sent
+        void drawPass(RenderPass pass)
+        {
+            // Swap to necessary shader
+            GLStateCache::useProgram(pyramidShader);
 
-            // Render relative to the camera
-            updateMVPArray(viewMatrix, projectionMatrix);
-            glUniformMatrix4fv(MVPMatrices_ref, 5, GL_FALSE, glm::value_ptr(MVPMatrices[0])); // Passing 6 matrices
+            // Pyramids are never culled
+            GLStateCache::setEnabled(GL_CULL_FACE, false);
+            setRenderPassState(pass);
 
-            //set timer in geometry shader
-            glUniform1f(geoTimerRef, (float)glfwGetTime());
+            // The shared mesh's VAO has the vertex layout
+            GLStateCache::bindVertexArray(geometry->getVertexArray());
 
-            // draw triangle faces
-            if(renderFaces)
+            // Place the pyramid, the camera's matrices and the timer are already in the frame's uniform buffer
+            glUniformMatrix4fv(modelMatrixRef, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+            if(normalMatrixRef >= 0)
             {
-                renderAsFaces();
+                glUniformMatrix3fv(normalMatrixRef, 1, GL_FALSE, glm::value_ptr(normalMatrix));
             }
 
-            // draw triangle wireframe
-            if(renderWireframe)
-            {
-                renderAsWireframe();
-            }
+            // Send colorType to shader, 1 for faces, 0 for wireframe and 2 for both
+            glUniform1i(colorTypeRef, getColorType(pass));
 
-            // reset bound buffers to original state
-            glDisableVertexAttribArray(0);
-            glDisableVertexAttribArray(1);
+            // Every face has its own three vertices
+            glDrawArrays(GL_TRIANGLES, 0, geometry->getVertexCount());
+            GLStateCache::countDraws(1);
+        }
+        const char* getProfileName(RenderPass pass)
+        {
+            const char* names[renderPassCount] = { "leaves", "leaves wireframe", "leaves + wireframe" };
+            return names[pass];
         }
         void fractalize()
         {
@@ -141,6 +163,41 @@ class SierpinskiPyramid {
         {
             resetPyramid();
         }
+        // Jumps straight to the given level, ready to draw when this returns
+        // Levels at or past the cap fall back to the default pyramid, same as fractalize()
+        // With LOD on this is the level drawn at the reference size, the next update() may pick another
+        void generateLevel(int newLevel)
+        {
+            detailLevel = wrapLevel(newLevel);
+            lodLevel = detailLevel;
+            // Only generated and uploaded if no other pyramid already has this level and color
+            geometry = SierpinskiGeometryCache::acquire(detailLevel, objectColor);
+            // Anything held for LOD is for the old level, let it go
+            previous.reset();
+            pending.reset();
+        }
+        // Changes the level, anything not built yet is built in the background
+        // The current level keeps being drawn until the new one is uploaded
+        void requestLevel(int newLevel)
+        {
+            detailLevel = wrapLevel(newLevel);
+            if(!lodEnabled)
+            {
+                lodLevel = detailLevel;
+            }
+        }
+        // Pyramids initialized after this draw with breathingShader.geo.glsl working out
+        // face normals every frame instead of reading them from the mesh
+        // Only kept to benchmark against, the two look the same
+        static void setGeometryShaderPath(bool enabled)
+        {
+            useGeometryShader() = enabled;
+        }
+        // Distance-based level of detail, off draws every tree at the requested level
+        void setLodEnabled(bool enabled)
+        {
+            lodEnabled = enabled;
+        }
         void toggleWireframe()
         {
             renderWireframe = !renderWireframe;
@@ -149,21 +206,26 @@ class SierpinskiPyramid {
         {
             renderFaces = !renderFaces;
         }
+        // Anything that moves the pyramid marks the model matrix to be rebuilt
         void setRotation(float angle, glm::vec3 axis)
         {
             rotationMatrix = glm::rotate(angle, axis);
+            modelDirty = true;
         }
         void rotate(float angle, glm::vec3 axis)
         {
             rotationMatrix *= glm::rotate(angle*rotationFactor, axis);
+            modelDirty = true;
         }
         void setPosition(const glm::vec3 &position)
         {
             translationMatrix = glm::translate(glm::mat4(1), position);
+            modelDirty = true;
         }
         void translate(const glm::vec3 &translation)
         {
             translationMatrix = glm::translate(translationMatrix, translation);
+            modelDirty = true;
         }
         void resetPosition()
         {
@@ -179,245 +241,192 @@ class SierpinskiPyramid {
             renderFaces = true;
             renderWireframe = false;
         }
+        // World-space box around the pyramid as it's currently placed
+        // Every level fits in the level 0 pyramid, so this doesn't depend on the level
+        AABB getBounds()
+        {
+            updateModelMatrix();
+            AABB bounds = getLocalBounds().transformed(modelMatrix);
+            // The shaders push faces out along their normals after the model transform
+            bounds.pad(breathingDistance);
+            return bounds;
+        }
+        // Size of the requested fractal level, for reporting
+        int getLevel()
+        {
+            return detailLevel;
+        }
+        // Vertices drawn, three for every face
+        int getVertexCount()
+        {
+            return sierpinskiIndexCount(detailLevel);
+        }
+        // Level actually being drawn right now, which LOD and background builds can make different
+        int getDrawnLevel()
+        {
+            return geometry->getLevel();
+        }
+        // Geometry to draw this frame, for drawing the pyramid as part of a batch
+        // Swaps in a newly picked level first if it's ready, like submit() does
+        const std::shared_ptr<SierpinskiGeometry> &getDrawnGeometry()
+        {
+            swapInLodGeometry();
+            return geometry;
+        }
+        // Matrices from the last update()
+        const glm::mat4 &getModelMatrix()
+        {
+            return modelMatrix;
+        }
+        const glm::mat3 &getNormalMatrix()
+        {
+            return normalMatrix;
+        }
+        // Passes this pyramid draws this frame, for drawing it as part of a batch
+        int getPasses(RenderPass passes[2])
+        {
+            return getRenderPasses(renderFaces, renderWireframe, passes);
+        }
     private:
+        // Don't let clicking go past level 5 for performance/crashing reasons
+        static const int levelCap = 5;
+        // Trees close to the camera can go further, only a few are ever that close
+        static const int maxLodLevel = 7;
+        // Screen size (fraction of the viewport's height) a tree is drawn at its requested level
+        // Every level halves the size of a tetrahedron, so each doubling of this adds a level
+        static constexpr float lodReferenceSize = 0.5f;
+        // How far past a level boundary the size has to go before switching, in levels
+        static constexpr float lodHysteresis = 0.25f;
+        // Furthest breathing moves a face, (sin()+1.05)*0.01 at most
+        static constexpr float breathingDistance = 0.0205f;
         glm::mat4 translationMatrix, scalingMatrix, rotationMatrix;
-        // MVPMatrices will contain the same data as the 3 matrices above, as well as passed View & Projection matrices
-        // The above matrices are just friendly names instead of requiring me to remember index 0,1,2 == O2Wmatrix etc
-        glm::mat4 MVPMatrices[5];
-        GLuint pyramidShader, positionBuffer, colorBuffer, vao, ibo;
-        GLint MVPMatrices_ref, colorTypeRef, geoTimerRef;
+        // The 3 matrices above multiplied together, only when one of them changes
+        glm::mat4 modelMatrix;
+        glm::mat3 normalMatrix;     // inverse transpose of the model matrix, for the face normals
+        bool modelDirty;
+        GLuint pyramidShader;
+        GLint modelMatrixRef, normalMatrixRef, colorTypeRef;
         GLFWwindow* window;
         glm::vec3 defaultPosition;  //Probably unecessary
         glm::vec3 objectColor;      //Color for the base shape
-        std::vector<glm::vec3> tetrahedronVerts, vertColors;
-        std::vector<Tetrahedron> tetrahedrons;
+        // Mesh and buffers for the level being drawn, shared with every other pyramid of this color
+        std::shared_ptr<SierpinskiGeometry> geometry;
+        // The level drawn before the last LOD switch, kept so switching straight back is free
+        // Anything older is dropped, so the cache can free levels no pyramid is near anymore
+        std::shared_ptr<SierpinskiGeometry> previous;
+        // The level LOD picked, built in the background and drawn once it's uploaded
+        std::shared_ptr<SierpinskiGeometry> pending;
+        int detailLevel;        // level requested by clicking
+        int lodLevel;           // level picked by the last update()
+        bool lodEnabled;
         bool renderFaces, renderWireframe;
-        int colorType, level;
+        int colorType;
         float rotationFactor;
-        // places matrices with friendly names in the correct position of an array
-        void updateMVPArray(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
-        {
-            // This order is *really* important
-            MVPMatrices[0] = scalingMatrix;
-            MVPMatrices[1] = rotationMatrix;
-            MVPMatrices[2] = translationMatrix;
-            MVPMatrices[3] = viewMatrix;
-            MVPMatrices[4] = projectionMatrix;
-        }
-        void renderAsFaces()
-        {  
-            // Set polygon mode to fill
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-            // Send colorType for faces to shader
-            glUniform1i(colorTypeRef, 1);
-
-            glDrawElements(
-                GL_TRIANGLES,
-                tetrahedrons.size()*12,
-                GL_UNSIGNED_INT,
-                (void*)0
-            );
+        // Levels at or past the cap fall back to the default pyramid
+        int wrapLevel(int newLevel)
+        {
+            if(newLevel >= levelCap || newLevel < 0)
+            {
+                return 0;
+            }
+            return newLevel;
         }
-        void renderAsWireframe()
+        static bool &useGeometryShader()
         {
-            // Set polygon mode to line
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-            // polygon offset line displaces the vertices towards the camera a little bit
-            glEnable(GL_POLYGON_OFFSET_LINE);
-            glPolygonOffset(0.1, -1);
-                      
-            // Send colorType for wireframe to shader
-            glUniform1i(colorTypeRef, 0);
-
-            // Actually draw wireframe
-            glDrawElements(
-                GL_TRIANGLES,
-                tetrahedrons.size()*12,
-                GL_UNSIGNED_INT,
-                (void*)0
-            );
-
-            glDisable(GL_POLYGON_OFFSET_LINE);
+            static bool enabled = false;
+            return enabled;
         }
-        // Sets data in the VBO based on fractal vertex data
-        void setVertexBufferData()
+        // Worked out once, getBounds() is called from the worker threads
+        static const AABB &getLocalBounds()
         {
-            GLfloat* vertices = new GLfloat[tetrahedronVerts.size()*3];
-            for(int i = 0; i < tetrahedronVerts.size(); i++)
+            static const AABB bounds = computeLocalBounds();
+            return bounds;
+        }
+        static AABB computeLocalBounds()
+        {
+            AABB bounds;
+            glm::vec3 corners[4];
+            sierpinskiBaseVertices(corners);
+            for(int i = 0; i < 4; i++)
             {
-                vertices[(i*3)+0] = tetrahedronVerts[i].x;
-                vertices[(i*3)+1] = tetrahedronVerts[i].y;
-                vertices[(i*3)+2] = tetrahedronVerts[i].z;
+                bounds.expand(corners[i]);
             }
-
-            glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                3*sizeof(GLfloat)*tetrahedronVerts.size(),
-                vertices,
-                GL_STATIC_DRAW
-            );
-            delete[] vertices;
-        }
-        // Sets data in the color buffer based on vertex color data
-        void setColorBufferData()
-        {
-            GLfloat* vertexColors = new GLfloat[tetrahedronVerts.size()*3];
-            for(int i = 0; i < tetrahedronVerts.size(); i++)
+            return bounds;
+        }
+        // Picks a level from the tree's projected size, relative to the requested level
+        // Only moves once the size is lodHysteresis past the next boundary, so a tree
+        // sitting right at one doesn't flicker between two levels
+        int selectLodLevel(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+        {
+            AABB bounds = getBounds();
+            float radius = glm::length(bounds.getExtent());
+            float depth = -(viewMatrix * glm::vec4(bounds.getCenter(), 1)).z;
+            if(depth <= radius)
             {
-                vertexColors[(i*3)+0] = vertColors[i].x;
-                vertexColors[(i*3)+1] = vertColors[i].y;
-                vertexColors[(i*3)+2] = vertColors[i].z;
+                // The camera is inside or right up against the tree
+                return maxLodLevel;
             }
-
-            glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                3*sizeof(GLfloat)*tetrahedronVerts.size(),
-                vertexColors,
-                GL_STATIC_DRAW
-            );
-            delete[] vertexColors;
-        }
-        // generates a color based on object color and a passed vertex position
-        glm::vec3 getColor(const glm::vec3 &vertexPos)
-        {
-            static float colorMultiplier = 2;
-            return objectColor + objectColor*colorMultiplier*vertexPos.y;
-        }
-        // Sets data in IBO based on fractal index data
-        void setIndexBufferData()
-        {
-            unsigned int* triIndices = new unsigned int[tetrahedrons.size()*4*3];
-            for(int i = 0; i < tetrahedrons.size(); i++)
+            float screenSize = radius * projectionMatrix[1][1] / depth;
+            float ideal = detailLevel + log2f(screenSize / lodReferenceSize);
+            int level = lodLevel;
+            if(ideal >= level + 1 + lodHysteresis || ideal < level - lodHysteresis)
+            {
+                level = (int)floorf(ideal);
+            }
+            // int() hands std::min a copy, maxLodLevel has no definition to take a reference to
+            return std::max(0, std::min(level, int(maxLodLevel)));
+        }
+        // Starts building the picked level if it's new, and draws it once it's uploaded
+        void swapInLodGeometry()
+        {
+            // Levels a build job let go of last are deleted here, on the GL thread
+            SierpinskiGeometryCache::releasePending();
+            if(geometry->getLevel() == lodLevel)
             {
-                for(int j = 0; j < 4; j++)      //j < 4 (faces per tetrahedron)
-                {            
-                    //        [i*12 indices per tetrahedron +
-                    //                  j*3 vertices per face +
-                    //                        x, y, z coord in a vertex]
-                    triIndices[(i*12) + (j*3)+0] = tetrahedrons[i].faces[j].x;
-                    triIndices[(i*12) + (j*3)+1] = tetrahedrons[i].faces[j].y;
-                    triIndices[(i*12) + (j*3)+2] = tetrahedrons[i].faces[j].z;
-                }
+                // Came back before the pending level finished, it isn't needed anymore
+                pending.reset();
+                return;
+            }
+            if(previous && previous->getLevel() == lodLevel)
+            {
+                // Already uploaded, it was drawn last
+                std::swap(geometry, previous);
+                pending.reset();
+                return;
+            }
+            if(!pending || pending->getLevel() != lodLevel)
+            {
+                pending = SierpinskiGeometryCache::request(lodLevel, objectColor);
+            }
+            if(pending->finishUpload())
+            {
+                previous = geometry;
+                geometry = pending;
+                pending.reset();
             }
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-            glBufferData(
-                GL_ELEMENT_ARRAY_BUFFER, 
-                12*sizeof(unsigned int)*tetrahedrons.size(),
-                triIndices,
-                GL_STATIC_DRAW
-            );
-            delete[] triIndices;
+        }
+        // translation * rotation * scaling, rebuilt only if the pyramid moved since the last call
+        void updateModelMatrix()
+        {
+            if(!modelDirty)
+            {
+                return;
+            }
+            modelMatrix = translationMatrix * rotationMatrix * scalingMatrix;
+            normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+            modelDirty = false;
         }
         // Resets fractal to a default pyramid
         void resetPyramid()
         {
-            tetrahedronVerts.clear();
-            vertColors.clear();
-            tetrahedrons.clear();
-            level = 0;
-
-            // A transformation to rotate initial tetrahedron to a more normal orientation
-            glm::mat4 pointUpMatrix = glm::rotate(glm::radians(-90.0f), glm::vec3(1, 0, 0));
-            glm::vec4 v0 = pointUpMatrix * glm::vec4(0.0, 0.0, 1, 0);
-            glm::vec4 v1 = pointUpMatrix * glm::vec4(0.0, 0.942809, -0.33333, 0);
-            glm::vec4 v2 = pointUpMatrix * glm::vec4(-0.816497, -0.471405, -0.333333, 0);
-            glm::vec4 v3 = pointUpMatrix * glm::vec4(0.816497, -0.471405, -0.333333, 0);
-
-            // Place vertices, color, and index data in vectors
-            tetrahedronVerts.push_back(glm::vec3(v0.x, v0.y, v0.z));
-            vertColors.push_back(getColor(v0));
-            tetrahedronVerts.push_back(glm::vec3(v1.x, v1.y, v1.z));
-            vertColors.push_back(getColor(v1));
-            tetrahedronVerts.push_back(glm::vec3(v2.x, v2.y, v2.z));
-            vertColors.push_back(getColor(v2));
-            tetrahedronVerts.push_back(glm::vec3(v3.x, v3.y, v3.z));
-            vertColors.push_back(getColor(v3));
-
-            tetrahedrons.push_back(Tetrahedron(0, 1, 2, 3));
-
-            // set data in graphics card
-            setVertexBufferData();
-            setColorBufferData();
-            setIndexBufferData();
+            requestLevel(0);
         }
         // Generates the next level of a sierpinski pyramid based on current tetrahedrons
+        // Builds in the background, so clicking never stalls a frame
         void fractalizePyramid()
         {
-            // Don't let tetrahedron go past level 5 for performance/crashing reasons
-            level++;
-            if(level == 5)
-            {
-                level = 0;
-                reset();
-            }
-            else
-            {
-                // Keep track of the number of tetrahedrons we started with
-                int startSize = tetrahedrons.size();
-                // For each initial tetrahedron, generate 4 more
-                for(int i = 0; i < startSize; i++)
-                {
-                    // Save vertex indices for clarity
-                    int v0 = tetrahedrons[i].verticesIdx[0];
-                    int v1 = tetrahedrons[i].verticesIdx[1];
-                    int v2 = tetrahedrons[i].verticesIdx[2];
-                    int v3 = tetrahedrons[i].verticesIdx[3];
-
-                    // Create vertices at midpoint of each edge, add to vertex vector
-                    glm::vec3 newVert = (tetrahedronVerts[v0] + tetrahedronVerts[v1])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    // Generate color data for the new vertex as well
-                    vertColors.push_back(getColor(newVert));
-                    // Save the index of each new vertex
-                    int v4 = tetrahedronVerts.size()-1;
-
-                    newVert = (tetrahedronVerts[v1] + tetrahedronVerts[v2])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    vertColors.push_back(getColor(newVert));
-                    int v5 = tetrahedronVerts.size()-1;
-
-                    newVert = (tetrahedronVerts[v2] + tetrahedronVerts[v0])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    vertColors.push_back(getColor(newVert));
-                    int v6 = tetrahedronVerts.size()-1;
-
-                    newVert = (tetrahedronVerts[v0] + tetrahedronVerts[v3])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    vertColors.push_back(getColor(newVert));
-                    int v7 = tetrahedronVerts.size()-1;
-
-                    newVert = (tetrahedronVerts[v1] + tetrahedronVerts[v3])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    vertColors.push_back(getColor(newVert));
-                    int v8 = tetrahedronVerts.size()-1;
-
-                    newVert = (tetrahedronVerts[v2] + tetrahedronVerts[v3])/2.0f;
-                    tetrahedronVerts.push_back(newVert);
-                    vertColors.push_back(getColor(newVert));
-                    int v9 = tetrahedronVerts.size()-1;
-
-                    // Add 4 new tetrahedrons
-                    tetrahedrons.push_back(Tetrahedron(v0, v6, v7, v4));
-                    tetrahedrons.push_back(Tetrahedron(v1, v8, v5, v4));
-                    tetrahedrons.push_back(Tetrahedron(v2, v9, v6, v5));
-                    tetrahedrons.push_back(Tetrahedron(v3, v9, v8, v7));
-                    
-                }
-                for(int i = 0; i < startSize; i++)
-                {
-                    // Remove the base tetrahedrons
-                    // TODO: why not just do this in the loop with the rest of 'em?
-                    // Oh well, it's not like this is really a large performance hit
-                    tetrahedrons.erase(tetrahedrons.begin());
-                }
-                setVertexBufferData();
-                setColorBufferData();
-                setIndexBufferData();
-            }
+            // requestLevel() wraps back to the default pyramid at the level cap
+            requestLevel(getLevel()+1);
         }
 };
 
@@ -0,0 +1,162 @@
+#ifndef SNOWPARTICLES_H
+#define SNOWPARTICLES_H
+
+//General includes
+#include <vector>
+
+// SSE is part of every x86-64 cpu, anything else gets the plain loops
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//Opengl includes
+#include <glm/glm.hpp>
+
+// Falling snow particles
+// Positions are stored as separate x, y, and z arrays so 4 particles can be
+// moved at once with SSE. update() writes the new positions straight into an
+// interleaved xyz array, usually a mapped instance buffer, so no per-particle
+// matrix is ever built.
+class SnowParticles {
+    public:
+        SnowParticles()
+        {
+            fallHeight = 5;
+            halfSizeX = 15;
+            halfSizeZ = 15;
+            wind = glm::vec3(0, 0, 0);
+        }
+        // Snow wraps back up by fallHeight after falling below 0
+        // and wraps around a (2*halfX) x (2*halfZ) area if blown by wind
+        void init(int maxParticles, float height, float halfX, float halfZ)
+        {
+            fallHeight = height;
+            halfSizeX = halfX;
+            halfSizeZ = halfZ;
+            x.clear();
+            y.clear();
+            z.clear();
+            x.reserve(maxParticles);
+            y.reserve(maxParticles);
+            z.reserve(maxParticles);
+        }
+        void add(const glm::vec3 &position)
+        {
+            x.push_back(position.x);
+            y.push_back(position.y);
+            z.push_back(position.z);
+        }
+        // Horizontal wind speed in units per second, only x and z are used
+        void setWind(const glm::vec3 &windSpeed)
+        {
+            wind = windSpeed;
+        }
+        int size()
+        {
+            return x.size();
+        }
+        glm::vec3 getPosition(int index)
+        {
+            return glm::vec3(x[index], y[index], z[index]);
+        }
+        // Moves every particle down by fallDistance (and along the wind for deltaTime seconds)
+        // then writes xyz triples for every particle into out
+        void update(float fallDistance, float deltaTime, float* out)
+        {
+            update(0, size(), fallDistance, deltaTime, out);
+        }
+        // Same as above for particles [begin, end) only
+        // Different ranges touch different memory, so they can run on different threads
+        void update(int begin, int end, float fallDistance, float deltaTime, float* out)
+        {
+            int i = begin;
+            bool windy = (wind.x != 0 || wind.z != 0);
+            float windX = wind.x*deltaTime;
+            float windZ = wind.z*deltaTime;
+
+#if defined(__SSE2__)
+            const __m128 fall = _mm_set1_ps(fallDistance);
+            const __m128 height = _mm_set1_ps(fallHeight);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 moveX = _mm_set1_ps(windX);
+            const __m128 moveZ = _mm_set1_ps(windZ);
+            const __m128 maxX = _mm_set1_ps(halfSizeX);
+            const __m128 maxZ = _mm_set1_ps(halfSizeZ);
+            const __m128 sizeX = _mm_set1_ps(2*halfSizeX);
+            const __m128 sizeZ = _mm_set1_ps(2*halfSizeZ);
+            for(; i+4 <= end; i += 4)
+            {
+                __m128 px = _mm_loadu_ps(&x[i]);
+                __m128 py = _mm_loadu_ps(&y[i]);
+                __m128 pz = _mm_loadu_ps(&z[i]);
+
+                // fall, then move anything below the ground back up
+                py = _mm_sub_ps(py, fall);
+                py = _mm_add_ps(py, _mm_and_ps(_mm_cmplt_ps(py, zero), height));
+
+                if(windy)
+                {
+                    px = _mm_add_ps(px, moveX);
+                    pz = _mm_add_ps(pz, moveZ);
+                    px = wrap(px, maxX, sizeX);
+                    pz = wrap(pz, maxZ, sizeZ);
+                    _mm_storeu_ps(&x[i], px);
+                    _mm_storeu_ps(&z[i], pz);
+                }
+                _mm_storeu_ps(&y[i], py);
+
+                // Interleave 4 particles into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+                __m128 xy01 = _mm_unpacklo_ps(px, py);      // x0 y0 x1 y1
+                __m128 xy23 = _mm_unpackhi_ps(px, py);      // x2 y2 x3 y3
+                __m128 z0x1 = _mm_shuffle_ps(pz, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+                __m128 y1z1 = _mm_shuffle_ps(xy01, pz, _MM_SHUFFLE(1, 1, 3, 3));
+                __m128 z2x3 = _mm_shuffle_ps(pz, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+                _mm_storeu_ps(out + i*3 + 0, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+                _mm_storeu_ps(out + i*3 + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+                _mm_storeu_ps(out + i*3 + 8, _mm_shuffle_ps(z2x3, z2x3, _MM_SHUFFLE(1, 3, 2, 0)));
+            }
+#endif
+            // Whatever doesn't fit in a group of 4
+            for(; i < end; i++)
+            {
+                y[i] -= fallDistance;
+                if(y[i] < 0)
+                {
+                    y[i] += fallHeight;
+                }
+                if(windy)
+                {
+                    x[i] = wrap(x[i] + windX, halfSizeX);
+                    z[i] = wrap(z[i] + windZ, halfSizeZ);
+                }
+                out[i*3 + 0] = x[i];
+                out[i*3 + 1] = y[i];
+                out[i*3 + 2] = z[i];
+            }
+        }
+    private:
+        std::vector<float> x, y, z;     // particle positions, structure of arrays
+        float fallHeight;               // height snow starts falling from
+        float halfSizeX, halfSizeZ;     // snow wraps around at +-halfSize
+        glm::vec3 wind;
+
+        // Keeps a coordinate within [-half, half]
+        float wrap(float value, float half)
+        {
+            if(value > half)
+            {   value -= 2*half;    }
+            else if(value < -half)
+            {   value += 2*half;    }
+            return value;
+        }
+#if defined(__SSE2__)
+        __m128 wrap(__m128 value, __m128 half, __m128 size)
+        {
+            __m128 tooFar = _mm_and_ps(_mm_cmpgt_ps(value, half), size);
+            __m128 tooNear = _mm_and_ps(_mm_cmplt_ps(value, _mm_sub_ps(_mm_setzero_ps(), half)), size);
+            return _mm_add_ps(_mm_sub_ps(value, tooFar), tooNear);
+        }
+#endif
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+//General includes
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <ostream>
+#include <iomanip>
+
+// Times the phases of startup as a tree and prints where the time went
+// Phases with the same name under the same parent are merged, so 100 calls
+// to one init show up as a single line with a call count. Counters (bytes
+// uploaded, programs compiled...) are added to whichever phase is open.
+// Only the thread that called start() is recorded, and nothing is recorded
+// after finish(), so the same code can run on workers or mid-frame for free.
+class StartupProfiler {
+    public:
+        // Opens the root phase on this thread
+        static void start(const char* name)
+        {
+            State &s = state();
+            // Workers can check recording() at any time, so it's off until everything is reset
+            s.running.store(false);
+            s.phases.clear();
+            s.stack.clear();
+            s.totals.clear();
+            s.owner.store(std::this_thread::get_id());
+            s.running.store(true);
+            begin(name);
+        }
+        // Closes the root phase and stops recording
+        static void finish()
+        {
+            State &s = state();
+            while(!s.stack.empty() && recording())
+            {
+                end();
+            }
+            s.running.store(false);
+        }
+        static void begin(const char* name)
+        {
+            if(!recording())
+            {
+                return;
+            }
+            State &s = state();
+            int parent = s.stack.empty() ? -1 : s.stack.back();
+            int index = findChild(parent, name);
+            if(index < 0)
+            {
+                Phase phase;
+                phase.name = name;
+                phase.ms = 0;
+                phase.calls = 0;
+                phase.parent = parent;
+                index = s.phases.size();
+                s.phases.push_back(phase);
+                if(parent >= 0)
+                {
+                    s.phases[parent].children.push_back(index);
+                }
+            }
+            s.phases[index].calls++;
+            s.phases[index].started = std::chrono::steady_clock::now();
+            s.stack.push_back(index);
+        }
+        static void end()
+        {
+            if(!recording() || state().stack.empty())
+            {
+                return;
+            }
+            State &s = state();
+            Phase &phase = s.phases[s.stack.back()];
+            phase.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - phase.started).count();
+            s.stack.pop_back();
+        }
+        // Adds amount to a counter on the open phase and to the overall total
+        static void count(const char* counter, double amount)
+        {
+            if(!recording() || state().stack.empty())
+            {
+                return;
+            }
+            State &s = state();
+            std::vector<std::pair<std::string, double> > &counters = s.phases[s.stack.back()].counters;
+            bool found = false;
+            for(int i = 0; i < counters.size() && !found; i++)
+            {
+                if(counters[i].first == counter)
+                {
+                    counters[i].second += amount;
+                    found = true;
+                }
+            }
+            if(!found)
+            {
+                counters.push_back(std::make_pair(std::string(counter), amount));
+            }
+            s.totals[counter] += amount;
+        }
+        // Total time of the root phase, in milliseconds
+        static double getTotalMs()
+        {
+            State &s = state();
+            return s.phases.empty() ? 0 : s.phases[0].ms;
+        }
+        // Prints every phase indented under its parent, then the counter totals
+        static void report(std::ostream &out)
+        {
+            State &s = state();
+            if(s.phases.empty())
+            {
+                return;
+            }
+            std::ios::fmtflags flags = out.flags();
+            std::streamsize precision = out.precision();
+            out << std::fixed;
+            printPhase(out, 0, 0);
+            out << "totals:";
+            for(std::map<std::string, double>::iterator it = s.totals.begin(); it != s.totals.end(); it++)
+            {
+                out << (it == s.totals.begin() ? " " : ", ") << it->first << " " << std::setprecision(0) << it->second;
+            }
+            out << std::endl;
+            out.flags(flags);
+            out.precision(precision);
+        }
+    private:
+        struct Phase {
+            std::string name;
+            double ms;
+            int calls;
+            int parent;
+            std::vector<int> children;
+            std::vector<std::pair<std::string, double> > counters;     // in the order they were first counted
+            std::chrono::steady_clock::time_point started;
+        };
+        struct State {
+            State()
+            {
+                running = false;
+                owner = std::thread::id();
+            }
+            // Both read by any thread, see recording()
+            std::atomic<bool> running;
+            std::atomic<std::thread::id> owner;
+            std::vector<Phase> phases;      // phases[0] is the root
+            std::vector<int> stack;         // phases currently open, innermost last
+            std::map<std::string, double> totals;
+        };
+        // Function-local so it exists before any global object uses it
+        static State &state()
+        {
+            static State current;
+            return current;
+        }
+        static bool recording()
+        {
+            State &s = state();
+            return s.running.load() && s.owner.load() == std::this_thread::get_id();
+        }
+        static int findChild(int parent, const char* name)
+        {
+            State &s = state();
+            if(parent < 0)
+            {
+                return -1;
+            }
+            std::vector<int> &children = s.phases[parent].children;
+            for(int i = 0; i < children.size(); i++)
+            {
+                if(s.phases[children[i]].name == name)
+                {
+                    return children[i];
+                }
+            }
+            return -1;
+        }
+        static void printPhase(std::ostream &out, int index, int depth)
+        {
+            State &s = state();
+            Phase &phase = s.phases[index];
+            std::string label = std::string(depth*2, ' ') + phase.name;
+            out << std::left << std::setw(36) << label << std::right
+                << std::setw(10) << std::setprecision(1) << phase.ms << " ms";
+            if(phase.calls > 1)
+            {
+                out << "  x" << phase.calls;
+            }
+            for(int i = 0; i < phase.counters.size(); i++)
+            {
+                out << (i == 0 ? "  [" : ", ") << phase.counters[i].first << " "
+                    << std::setprecision(0) << phase.counters[i].second;
+            }
+            if(!phase.counters.empty())
+            {
+                out << "]";
+            }
+            out << std::endl;
+            for(int i = 0; i < phase.children.size(); i++)
+            {
+                printPhase(out, phase.children[i], depth+1);
+            }
+        }
+};
+
+// Times a phase from construction to the end of the enclosing scope
+class ScopedPhase {
+    public:
+        ScopedPhase(const char* name)
+        {
+            StartupProfiler::begin(name);
+        }
+        ~ScopedPhase()
+        {
+            StartupProfiler::end();
+        }
+    private:
+        ScopedPhase(const ScopedPhase&);
+        ScopedPhase &operator=(const ScopedPhase&);
+};
+
+#endif
@@ -3,19 +3,34 @@
 
 in vec3 fragColor;
 in vec3 vNormal;
+noperspective in vec3 barycentric;
 
 uniform int colorType;
 
 out vec4 color;
 
+// 0 on a triangle's edges, 1 more than about a pixel away from all of them
+// Roughly the width of a GL_LINE wireframe, at any distance
+float edgeFactor()
+{
+    vec3 width = fwidth(barycentric);
+    vec3 fromEdge = smoothstep(vec3(0.0), width, barycentric);
+    return min(min(fromEdge.x, fromEdge.y), fromEdge.z);
+}
+
 void main() {
     //Dynamically switch between color types
     if(colorType == 0)
     {
         color = vec4(vNormal, 1);
     }
-    else
+    else if(colorType == 1)
     {
         color = vec4(fragColor, 1);
     }
+    else
+    {
+        // Faces and wireframe in one pass
+        color = vec4(mix(vNormal, fragColor, edgeFactor()), 1);
+    }
 }
\ No newline at end of file
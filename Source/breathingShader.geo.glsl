@@ -6,13 +6,20 @@ layout(triangles) in;
 layout(triangle_strip, max_vertices=3) out;
 
 in vec3 fragColor0[];
-uniform float geoTimer;
-//Matrices arranged in this order:
-//[0]scaling, [1]rotation, [2]translation, [3]view, [4]projection
-uniform mat4 matrices[5];
+// translation * rotation * scaling, only rebuilt on the CPU when the pyramid moves
+uniform mat4 modelMatrix;
+// Shared by every draw in the frame, see FrameUniforms.h
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    float time;
+};
 
 out vec3 fragColor;
 out vec3 vNormal;
+// Which corner of the triangle each vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
 
 // Returns the normal for a CCW triangle
 vec3 getNormal(vec4 v0, vec4 v1, vec4 v2)
@@ -27,16 +34,15 @@ vec3 getNormal(vec4 v0, vec4 v1, vec4 v2)
 // According to sin() of a timer
 vec4 breathe(vec4 position, vec3 normal)
 {
-    vec3 direction = normal * (sin(geoTimer*2)+1.05) * 0.01;
+    vec3 direction = normal * (sin(time*2)+1.05) * 0.01;
     return position + vec4(direction, 0.0);
 }
 
 void main() {
-    // Generate M/VP matrix
-    // Divide up like this to get normals after object to world transforms
+    // Get normals after object to world transforms
     // but before view/projection
-    mat4 M = matrices[2] * matrices[1] * matrices[0];
-    mat4 VP = matrices[4] * matrices[3];
+    mat4 M = modelMatrix;
+    mat4 VP = viewProjectionMatrix;
 
     // Object to world transform
     vec4 v0 = M * gl_in[0].gl_Position;
@@ -54,17 +60,20 @@ void main() {
     gl_Position = VP * breathe(v0, normal_face);
     fragColor = fragColor0[0];
     vNormal = normal_face;
+    barycentric = vec3(1, 0, 0);
     EmitVertex();
 
     gl_Position = VP * breathe(v1, normal_face);
     fragColor = fragColor0[1];
     // vNormal = normal_face;   // Don't need to do this for every vertex
                                 // But clarity is nice
+    barycentric = vec3(0, 1, 0);
     EmitVertex();
 
     gl_Position = VP * breathe(v2, normal_face);
     fragColor = fragColor0[2];
     // vNormal = normal_face;
+    barycentric = vec3(0, 0, 1);
     EmitVertex();
 
     EndPrimitive();
@@ -0,0 +1,49 @@
+#version 330 core
+//VERTEX SHADER
+// Does what passthrough.vrt.glsl + breathingShader.geo.glsl used to, without a geometry stage
+// The face normal comes in as an attribute, worked out once on the CPU
+
+// layout location needs to match attribute in glVertexAttribPointer()
+layout(location = 0) in vec3 vPosition_Modelspace;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec3 vNormal_Modelspace;
+
+// translation * rotation * scaling and its inverse transpose, only rebuilt on the CPU when the pyramid moves
+uniform mat4 modelMatrix;
+uniform mat3 normalMatrix;
+// Shared by every draw in the frame, see FrameUniforms.h
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    float time;
+};
+
+out vec3 fragColor;
+out vec3 vNormal;
+// Which corner of its face this vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
+
+// Breathe function
+// Just translates each vertex along a vector (in this instance the normal)
+// According to sin() of a timer
+vec4 breathe(vec4 position, vec3 normal)
+{
+    vec3 direction = normal * (sin(time*2)+1.05) * 0.01;
+    return position + vec4(direction, 0.0);
+}
+
+void main() {
+    // Every vertex of a face has the same normal, so the face still moves as one
+    vec3 normal_face = normalize(normalMatrix * vNormal_Modelspace);
+
+    // Object to world transform, then breathing and View/Projection transforms
+    // Breathing happens after object to world, so it's the same size for every pyramid
+    gl_Position = viewProjectionMatrix * breathe(modelMatrix * vec4(vPosition_Modelspace, 1.0), normal_face);
+    fragColor = vertexColor;
+    vNormal = normal_face;
+
+    // Every face has its own three vertices in a row, starting at a multiple of 3
+    barycentric = vec3(0.0);
+    barycentric[gl_VertexID % 3] = 1.0;
+}
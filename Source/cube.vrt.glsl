@@ -0,0 +1,36 @@
+#version 330 core
+//VERTEX SHADER
+// Cubes, drawn with or without passthrough.geo.glsl
+
+// layout location needs to match attribute in glVertexAttribPointer()
+layout(location = 0) in vec3 vPosition_Modelspace;
+layout(location = 1) in vec3 vertexColor;
+// translation * rotation * scaling, only rebuilt on the CPU when the cube moves
+uniform mat4 modelMatrix;
+// Shared by every draw in the frame, see FrameUniforms.h
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    float time;
+};
+
+// fragColor0 feeds passthrough.geo.glsl when the geometry stage is used, fragColor the fragment shader otherwise
+// Whichever isn't read is dropped when the program is linked
+out vec3 fragColor0;
+out vec3 fragColor;
+// Which corner of its face this vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
+
+void main() {
+    // Two matrix-vector products, no matrix-matrix products per vertex
+    gl_Position = viewProjectionMatrix * (modelMatrix * vec4(vPosition_Modelspace, 1.0));
+
+    //forward color data on to fragment shader
+    fragColor0 = vertexColor;
+    fragColor = vertexColor;
+
+    // Every face has its own three vertices in a row, starting at a multiple of 3
+    barycentric = vec3(0.0);
+    barycentric[gl_VertexID % 3] = 1.0;
+}
@@ -0,0 +1,64 @@
+#version 330 core
+//VERTEX SHADER
+// Leaves and trunks for the whole forest, drawn by ForestBatch.h
+// Every object's matrices come from a buffer texture instead of a uniform,
+// so one draw can place any number of them
+
+// layout location needs to match attribute in glVertexAttribPointer()
+layout(location = 0) in vec3 vPosition_Modelspace;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec3 vNormal_Modelspace;
+// Counts up once per instance, starting at the draw's base instance
+layout(location = 3) in int objectIndex;
+
+// 8 texels per object: model matrix columns, normal matrix columns, then the tint
+uniform samplerBuffer objectData;
+// Added to objectIndex by draws that can't set a base instance
+uniform int instanceOffset;
+// 1 for leaves, 0 for trunks
+uniform float breathing;
+// Shared by every draw in the frame, see FrameUniforms.h
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    float time;
+};
+
+out vec3 fragColor;
+out vec3 vNormal;
+// Which corner of its face this vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
+
+// Breathe function
+// Same as breathingShader.vrt.glsl, scaled so trunks don't move
+vec4 breathe(vec4 position, vec3 normal)
+{
+    vec3 direction = normal * (sin(time*2)+1.05) * 0.01 * breathing;
+    return position + vec4(direction, 0.0);
+}
+
+void main() {
+    int base = (objectIndex + instanceOffset) * 8;
+    mat4 modelMatrix = mat4(
+        texelFetch(objectData, base + 0),
+        texelFetch(objectData, base + 1),
+        texelFetch(objectData, base + 2),
+        texelFetch(objectData, base + 3)
+    );
+    mat3 normalMatrix = mat3(
+        texelFetch(objectData, base + 4).xyz,
+        texelFetch(objectData, base + 5).xyz,
+        texelFetch(objectData, base + 6).xyz
+    );
+    vec3 tint = texelFetch(objectData, base + 7).rgb;
+
+    vec3 normal_face = normalize(normalMatrix * vNormal_Modelspace);
+    gl_Position = viewProjectionMatrix * breathe(modelMatrix * vec4(vPosition_Modelspace, 1.0), normal_face);
+    fragColor = vertexColor * tint;
+    vNormal = normal_face;
+
+    // Every face has its own three vertices in a row, starting at a multiple of 3
+    barycentric = vec3(0.0);
+    barycentric[gl_VertexID % 3] = 1.0;
+}
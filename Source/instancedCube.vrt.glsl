@@ -0,0 +1,37 @@
+#version 330 core
+//VERTEX SHADER
+
+// layout location needs to match attribute in glVertexAttribPointer()
+// locations 0 and 1 match the other shaders, the rest are per-instance
+layout(location = 0) in vec3 vPosition_Modelspace;
+layout(location = 2) in vec3 instancePosition;
+layout(location = 3) in mat3 instanceScaleRotation;    // uses locations 3, 4 and 5
+layout(location = 6) in vec3 instanceColor;
+// Shared by every draw in the frame, see FrameUniforms.h
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    float time;
+};
+
+// fragColor0 feeds passthrough.geo.glsl when the geometry stage is used, fragColor the fragment shader otherwise
+// Whichever isn't read is dropped when the program is linked
+out vec3 fragColor0;
+out vec3 fragColor;
+// Which corner of its face this vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
+
+void main() {
+    // Scale and rotate, then move to this instance's position
+    vec3 vPosition_Worldspace = instanceScaleRotation * vPosition_Modelspace + instancePosition;
+    gl_Position = viewProjectionMatrix * vec4(vPosition_Worldspace, 1.0);
+
+    //forward color data on to fragment shader
+    fragColor0 = instanceColor;
+    fragColor = instanceColor;
+
+    // Every face has its own three vertices in a row, starting at a multiple of 3
+    barycentric = vec3(0.0);
+    barycentric[gl_VertexID % 3] = 1.0;
+}
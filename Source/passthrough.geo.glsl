@@ -8,19 +8,24 @@ layout(triangle_strip, max_vertices=3) out;
 in vec3 fragColor0[];
 
 out vec3 fragColor;
+// Which corner of the triangle each vertex is, for single-pass wireframe
+noperspective out vec3 barycentric;
 
 void main() {
     // Apply View/Projection transforms and breathing effect
     gl_Position = gl_in[0].gl_Position;
     fragColor = fragColor0[0];
+    barycentric = vec3(1, 0, 0);
     EmitVertex();
 
     gl_Position = gl_in[1].gl_Position;
     fragColor = fragColor0[1];
+    barycentric = vec3(0, 1, 0);
     EmitVertex();
 
     gl_Position = gl_in[2].gl_Position;
     fragColor = fragColor0[2];
+    barycentric = vec3(0, 0, 1);
     EmitVertex();
 
     EndPrimitive();